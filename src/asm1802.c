@@ -10,6 +10,7 @@ enum
     OP_Immediate,    // 8-bit immediate operand
     OP_Branch,       // short branch
     OP_LBranch,      // long branch
+    OP_JBranch,      // short branch if the target is on the same page, else long branch
     OP_INPOUT        // INP/OUT instruction
 
 //  o_Foo = OP_LabelOp,
@@ -106,6 +107,19 @@ static const struct OpcdRec R1802_opcdTab[] =
     {"SHL", OP_None,     0xFE},
     {"SMI", OP_Immediate,0xFF},
 
+    // generic branches, parm is the short branch opcode
+    {"JBR", OP_JBranch,  0x30},
+    {"JBQ", OP_JBranch,  0x31},
+    {"JBZ", OP_JBranch,  0x32},
+    {"JBDF",OP_JBranch,  0x33},
+    {"JBPZ",OP_JBranch,  0x33}, // duplicate opcode
+    {"JBGE",OP_JBranch,  0x33}, // duplicate opcode
+    {"JBNQ",OP_JBranch,  0x39},
+    {"JBNZ",OP_JBranch,  0x3A},
+    {"JBNF",OP_JBranch,  0x3B},
+    {"JBM", OP_JBranch,  0x3B}, // duplicate opcode
+    {"JBL", OP_JBranch,  0x3B}, // duplicate opcode
+
     {"",    OP_Illegal,  0}
 };
 
@@ -193,6 +207,22 @@ static int R1802_DoCPUOpcode(int typ, int parm)
             INSTR_BW(parm, val);
             break;
 
+        case OP_JBranch:
+            val = EXPR_Eval();
+            // the page depends on the size of earlier branches, so let
+            // RELAX_Site keep this one long once it has needed to be
+            if (RELAX_Site(evalKnown && ((locPtr + 1) & 0xFF00) == (val & 0xFF00)))
+            {
+                INSTR_BB(parm, val);
+                RELAX_Note("JBcc->Bcc", 1, 1);
+            }
+            else
+            {
+                INSTR_BW(parm + 0x90, val); // LBcc
+                RELAX_Note("JBcc->LBcc", 0, 0);
+            }
+            break;
+
         case OP_INPOUT:
             val = EXPR_Eval();
             if (val < 1 || val > 7)
@@ -737,6 +737,40 @@ static int M6502_DoCPUOpcode(int typ, int parm)
                 }
             }
 
+            // count the forms that --relax picked from final symbol values
+            if (evalRelaxed)
+            {
+                switch (mode)
+                {
+                    case MADR_Zpg:
+                        RELAX_Note("abs->zero page", 1, 1);
+                        break;
+
+                    case MADR_Zpx:
+                        if (modes[MADR_Abx] != 0)
+                        {
+                            RELAX_Note("abs->zero page", 1, 1);
+                        }
+                        break;
+
+                    case MADR_Zpy:
+                        if (modes[MADR_Aby] != 0)
+                        {
+                            RELAX_Note("abs->zero page", 1, 1);
+                        }
+                        break;
+
+                    case MADR_AbL:
+                    case MADR_ALX:
+                        // this is correct where abs would be truncated, but a byte longer
+                        RELAX_Note("abs->abs long", -1, -1);
+                        break;
+
+                    default:
+                        break;
+                }
+            }
+
             instrLen = 0;
             switch (mode)
             {
@@ -24,6 +24,7 @@ enum
     OP_QArith,       // 6309 OP_Arith with 4-byte immediate
     OP_TFM,          // 6309 TFM instruction
     OP_Bit,          // 6309 bit manipulation instructions
+    OP_JRelative,    // generic branch, short or long whichever fits
 
     OP_6309 = 0x8000, // add to parm value for 6309 opcodes
 
@@ -112,6 +113,26 @@ static const struct OpcdRec M6809_opcdTab[] =
     {"LBGT",  OP_LRelative, 0x102E},
     {"LBLE",  OP_LRelative, 0x102F},
 
+    {"JBRA",  OP_JRelative, 0x20},
+    {"JBSR",  OP_JRelative, 0x8D},
+    {"JBRN",  OP_JRelative, 0x21},
+    {"JBHI",  OP_JRelative, 0x22},
+    {"JBLS",  OP_JRelative, 0x23},
+    {"JBCC",  OP_JRelative, 0x24},
+    {"JBCS",  OP_JRelative, 0x25},
+    {"JBHS",  OP_JRelative, 0x24},
+    {"JBLO",  OP_JRelative, 0x25},
+    {"JBNE",  OP_JRelative, 0x26},
+    {"JBEQ",  OP_JRelative, 0x27},
+    {"JBVC",  OP_JRelative, 0x28},
+    {"JBVS",  OP_JRelative, 0x29},
+    {"JBPL",  OP_JRelative, 0x2A},
+    {"JBMI",  OP_JRelative, 0x2B},
+    {"JBGE",  OP_JRelative, 0x2C},
+    {"JBLT",  OP_JRelative, 0x2D},
+    {"JBGT",  OP_JRelative, 0x2E},
+    {"JBLE",  OP_JRelative, 0x2F},
+
     {"LEAX",  OP_Indexed, 0x30},
     {"LEAY",  OP_Indexed, 0x31},
     {"LEAS",  OP_Indexed, 0x32},
@@ -545,6 +566,10 @@ static void M6809_Indexed(int idxOp, int dirOp, int extOp)
 //                          if ((val & 0xFF00) >> 8 != 0 && (val & 0xFF00) >> 8 != dpReg && force == '<')
 //                              ASMX_Warning("High byte of operand does not match SETDP value");
                             INSTR_XB(dirOp, val);    // <$xx
+                            if (evalRelaxed && force != '<')
+                            {
+                                RELAX_Note("extended->direct", 1, 1);
+                            }
                         }
                         else
                         {
@@ -580,6 +605,10 @@ static void M6809_Indexed(int idxOp, int dirOp, int extOp)
                                     || force == '<')
                             {
                                 INSTR_XBB(idxOp, 0x8C + indirect, val);       // nn,PCR
+                                if (evalRelaxed && force != '<')
+                                {
+                                    RELAX_Note("nnnn,PCR->nn,PCR", 1, 4);
+                                }
                             }
                             else
                             {
@@ -596,10 +625,18 @@ static void M6809_Indexed(int idxOp, int dirOp, int extOp)
                         if (force != '>' && evalKnown && !indirect && -16 <= val && val <= 15)
                         {
                             INSTR_XB(idxOp, reg * 0x20 + (val & 0x1F));  // n,X
+                            if (evalRelaxed)
+                            {
+                                RELAX_Note("nnnn,X->n,X", 2, 3);
+                            }
                         }
                         else if (evalKnown && -128 <= val && val <= 127)
                         {
                             INSTR_XBB(idxOp, reg * 0x20 + 0x88 + indirect, val);  // nn,X
+                            if (evalRelaxed)
+                            {
+                                RELAX_Note("nnnn,X->nn,X", 1, 3);
+                            }
                         }
                         else
                         {
@@ -679,6 +716,32 @@ static int M6809_DoCPUOpcode(int typ, int parm)
             INSTR_XW(parm, val);
             break;
 
+        case OP_JRelative:
+            val = EXPR_Eval() - locPtr;
+            if (evalKnown && -128 <= val - 2 && val - 2 <= 127)
+            {
+                INSTR_XB(parm, val - 2);
+                if (evalRelaxed)
+                {
+                    // the long forms take two more cycles, and LBcc is a byte
+                    // longer than LBRA and LBSR because of its prefix
+                    RELAX_Note("LBcc->Bcc", (parm == 0x20 || parm == 0x8D) ? 1 : 2, 2);
+                }
+            }
+            else if (parm == 0x20)
+            {
+                INSTR_XW(0x16, val - 3);   // LBRA
+            }
+            else if (parm == 0x8D)
+            {
+                INSTR_XW(0x17, val - 3);   // LBSR
+            }
+            else
+            {
+                INSTR_XW(parm + 0x1000, val - 4);
+            }
+            break;
+
         case OP_Indexed:
             M6809_Indexed(parm, -1, -1);
             break;
@@ -1227,14 +1227,22 @@ static int M68K_DoCPUOpcode(int typ, int parm)
                     }
 #else
                     // if not a forward reference, can choose W or B branch
+                    // (with --relax, forward references are known after the first pass 1 iteration)
+                    // a branch to the next instruction has offset 0 in the short form,
+                    // so it would flip between forms; RELAX_Site() keeps it in the word form
                     val = EXPR_EvalWBranch(2);
-                    if (evalKnown && -128 <= val && val <= 127 && val != 0 && val != 0xFF)
+                    if (RELAX_Site(evalKnown && -128 <= val && val <= 127 && val != 0 && val != 0xFF))
                     {
                         INSTR_W((parm & 0xFF00) + (val & 0x00FF));
+                        if (evalRelaxed)
+                        {
+                            RELAX_Note("Bcc.S", 2, 0);
+                        }
                     }
                     else
                     {
-                        if (val != 0 && -128 <= val && val <= 129 && !exactFlag)
+                        // a branch to the next instruction (val == 2) can't be short
+                        if (val != 0 && val != 2 && -128 <= val && val <= 129 && !exactFlag)
                         {
                             // max is +129 because short branch saves 2 bytes
                             ASMX_Warning("Short branch could be used here");
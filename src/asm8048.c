@@ -40,7 +40,7 @@ enum instrType
     OP_INS,          // INS
     OP_OUTL,         // OUTL
 
-//  o_Foo = OP_LabelOp,
+    OP_SELMB = OP_LabelOp,  // SELMB pseudo-op
 };
 
 // Note: there seem to be three primary variations of the instruction set:
@@ -141,6 +141,7 @@ static const struct OpcdRec I8048_opcdTab[] =
     {"INS",  OP_INS,     0x00},
     {"OUTL", OP_OUTL,    0x00}, // OUTL DBB,A is 0x90 on 8041/8021/8022
 
+    {"SELMB",OP_SELMB,   0x00},
 
     {"",    OP_Illegal,  0}
 };
@@ -173,8 +174,18 @@ enum
 // This can be subverted through bad programming style, but should be
 // sufficient if SEL MB is always set before long jumps/calls. (And
 // presumably set back after long calls as well.)
+//
+// With SELMB AUTO, SEL MBx is inserted before JMP and CALL when needed,
+// and an explicit SEL MBx is removed when selmb already has that value.
+// Then selmb can also be -2 for a bank that is unknown and may not be
+// the current page, so SEL MBx is inserted to set it back to the current
+// page before code that can be reached from elsewhere (labels and
+// conditional branches) and before returns.
 
 int selmb;
+bool mbAuto;    // true to insert and remove SEL MBx automatically (SELMB AUTO)
+int mbLabels;   // value of codeLabels at the previous instruction
+int mbSel;      // bank for a SEL MBx inserted before this instruction, or -1
 
 // --------------------------------------------------------------
 
@@ -200,6 +211,28 @@ static int I8048_GetReg(const char *regList)
 }
 
 
+// returns the memory bank of the current instruction
+static int I8048_CurBank(void)
+{
+    return (locPtr >> 11) & 1;
+}
+
+
+// with SELMB AUTO, this sets the memory bank back to the current page
+// if a SEL MBx or a long CALL could have left it different
+static void I8048_FixMB(void)
+{
+    int bank = I8048_CurBank();
+
+    if (!RELAX_Site(selmb == -1 || selmb == bank))
+    {
+        mbSel = bank;
+        selmb = -1;
+        RELAX_Note("SEL MB inserted", 0, 0);
+    }
+}
+
+
 static int I8048_DoCPUOpcode(int typ, int parm)
 {
     int     val, reg1, reg2;
@@ -207,6 +240,27 @@ static int I8048_DoCPUOpcode(int typ, int parm)
 //  char    *oldLine;
 //  int     token;
 
+    mbSel = -1;
+    if (mbAuto)
+    {
+        bool labelSeen = (mbLabels != codeLabels);
+        mbLabels = codeLabels;
+
+        if (typ == OP_JMP)
+        {
+            // the JMP or CALL will do its own SEL MBx if needed
+            if (labelSeen && selmb != -1 && selmb != I8048_CurBank())
+            {
+                selmb = -2;
+            }
+        }
+        else if (labelSeen || typ == OP_Branch || typ == OP_DJNZ || typ == OP_RET
+                 || (typ == OP_JMPP && parm == 0xB3))
+        {
+            I8048_FixMB();
+        }
+    }
+
     switch (typ)
     {
         case OP_RET:
@@ -354,6 +408,41 @@ static int I8048_DoCPUOpcode(int typ, int parm)
         case OP_JMP:
             val = EXPR_Eval();
 
+            if (mbAuto)
+            {
+                // insert SEL MBx if the bank isn't already the target's bank
+                int bank = (val >> 11) & 1;
+                int cur = (selmb == -1) ? I8048_CurBank() : selmb;
+
+                if (RELAX_Site(evalKnown && cur == bank))
+                {
+                    RELAX_Note("SEL MB omitted", 1, 1);
+                }
+                else
+                {
+                    mbSel = bank;
+                    RELAX_Note("SEL MB inserted", 0, 0);
+                }
+
+                if (parm == 0x04)
+                {
+                    // the JMP target's bank is its own page
+                    selmb = -1;
+                }
+                else if (!evalKnown)
+                {
+                    // a CALL returns with the bank of the forward target
+                    selmb = -2;
+                }
+                else
+                {
+                    selmb = (bank == I8048_CurBank()) ? -1 : bank;
+                }
+
+                INSTR_BB(parm + ((val & 0x0700) >> 3), val & 0xFF);
+                break;
+            }
+
             // check for jumps to the other SEL MB area
             if (selmb == -1)
             {
@@ -383,7 +472,7 @@ static int I8048_DoCPUOpcode(int typ, int parm)
 
         case OP_Branch:
             val = EXPR_Eval();
-            if ((val & 0xFF00) != ((locPtr + 2) & 0xFF00))
+            if ((val & 0xFF00) != ((locPtr + (mbSel >= 0) + 2) & 0xFF00))
             {
                 ASMX_Warning("Branch out of range");
             }
@@ -404,7 +493,7 @@ static int I8048_DoCPUOpcode(int typ, int parm)
                 case REG_R7:
                     if (TOKEN_Comma()) break;
                     val = EXPR_Eval();
-                    if ((val & 0xFF00) != ((locPtr + 2) & 0xFF00))
+                    if ((val & 0xFF00) != ((locPtr + (mbSel >= 0) + 2) & 0xFF00))
                     {
                         ASMX_Warning("Branch out of range");
                     }
@@ -823,6 +912,14 @@ static int I8048_DoCPUOpcode(int typ, int parm)
             {
                 case 2: // MB0
                 case 3: // MB1
+                    // with SELMB AUTO, remove it if the bank is already known
+                    if (mbAuto && RELAX_Site(selmb == reg1 - 2))
+                    {
+                        RELAX_Note("SEL MB removed", 1, 1);
+                        reg1 = reg_EOL;
+                        break;
+                    }
+
                     // remember last SEL MBx
                     selmb = reg1 - 2;
                     break;
@@ -910,6 +1007,63 @@ static int I8048_DoCPUOpcode(int typ, int parm)
             return 0;
             break;
     }
+
+    if (mbSel >= 0 && instrLen > 0)
+    {
+        // put the inserted SEL MBx in front of the instruction
+        memmove(bytStr + 1, bytStr, instrLen);
+        bytStr[0] = 0xE5 + mbSel*16;
+        instrLen++;
+    }
+
+    return 1;
+}
+
+
+static int I8048_DoCPULabelOp(int typ, int parm, char *labl)
+{
+    (void) parm; // unused parameter
+
+    switch (typ)
+    {
+        case OP_SELMB:
+            // SELMB pseudo-op
+            // SELMB AUTO inserts SEL MBx before JMP and CALL when needed,
+            // and SELMB OFF goes back to only warning about them
+
+            if (labl[0])
+            {
+                ASMX_Error("Label not allowed");
+            }
+
+            switch (REG_Get("OFF AUTO"))
+            {
+                case 0: // OFF
+                    mbAuto = false;
+                    if (selmb < 0)
+                    {
+                        selmb = -1;
+                    }
+                    break;
+
+                case 1: // AUTO
+                    mbAuto = true;
+                    mbLabels = codeLabels;
+                    break;
+
+                case reg_EOL:
+                    break;
+
+                default:
+                    ASMX_IllegalOperand();
+                    break;
+            }
+            break;
+
+        default:
+            return 0;
+            break;
+    }
     return 1;
 }
 
@@ -918,12 +1072,14 @@ void I8048_PassInit(void)
 {
     // start each pass with last selmb page undefined
     selmb = -1;
+    mbAuto = false;
+    mbLabels = codeLabels;
 }
 
 
 void I8048_AsmInit(void)
 {
-    void *p = ASMX_AddAsm(versionName, &I8048_DoCPUOpcode, NULL, &I8048_PassInit);
+    void *p = ASMX_AddAsm(versionName, &I8048_DoCPUOpcode, &I8048_DoCPULabelOp, &I8048_PassInit);
 
     ASMX_AddCPU(p, "8048",  CPU_8048, END_LITTLE, ADDR_16, LIST_24, 8, 0, I8048_opcdTab);
 //  ASMX_AddCPU(p, "8041",  CPU_8041, LITTLE_END, ADDR_16, LIST_24, 8, 0, I8048_opcdTab);
@@ -20,7 +20,8 @@ enum instrType
     OP_XCHD,     // XCHD A,@R0/@R1
     OP_PushPop,  // POP PUSH - parameter is direct address
     OP_A_bit_C,  // SETB CLR CPL - accepts A, bit, C, except SETB does not accept A
-    MOP_JMP,      // JMP @A+DPTR
+    MOP_JMP,      // JMP @A+DPTR, or JMP addr as SJMP AJMP or LJMP
+    MOP_CALL,    // CALL addr as ACALL or LCALL
     OP_MOVC,     // MOVC A,@A+DPTR/PC
     OP_MOVX,     // MOVX A to or from @DPTR, @R0, @R1
     OP_CJNE,     // CJNE @R0, @R1, A, R0-R7, dir with immediate and relative operands
@@ -93,6 +94,7 @@ static const struct OpcdRec I8051_opcdTab[] =
     {"SETB", OP_A_bit_C, 0x00D2},
 
     {"JMP",  MOP_JMP,  0x00},
+    {"CALL", MOP_CALL, 0x00},
 
     {"MOVC", OP_MOVC, 0x00},
 
@@ -236,6 +238,35 @@ static int I8051_EvalBitReg()
 }
 
 
+// assemble a generic JMP or CALL using the shortest form that reaches
+// the target: SJMP if it is in range, else AJMP/ACALL if it is in the
+// same 2K page as the next instruction, else LJMP/LCALL
+static void I8051_JmpCall(bool call)
+{
+    int val = EXPR_Eval();
+    int ofs = val - (locPtr + 2);
+
+    // this must be called every time to keep the site numbers in sync
+    bool page = RELAX_Site(evalKnown && (val & 0xF800) == ((locPtr + 2) & 0xF800));
+
+    if (!call && evalKnown && -128 <= ofs && ofs <= 127)
+    {
+        INSTR_BB(0x80, ofs);
+        RELAX_Note("JMP->SJMP", 1, 0);
+    }
+    else if (page)
+    {
+        INSTR_BB((call ? 0x11 : 0x01) + ((val & 0x0700) >> 3), val & 0xFF);
+        RELAX_Note(call ? "CALL->ACALL" : "JMP->AJMP", 1, 0);
+    }
+    else
+    {
+        INSTR_BW(call ? 0x12 : 0x02, val);
+        RELAX_Note(call ? "CALL->LCALL" : "JMP->LJMP", 0, 0);
+    }
+}
+
+
 static int I8051_DoCPUOpcode(int typ, int parm)
 {
     int     val, reg1, reg2;
@@ -793,10 +824,13 @@ static int I8051_DoCPUOpcode(int typ, int parm)
             switch (I8051_GetReg("@A"))
             {
                 default:
-                case reg_None:
                     ASMX_IllegalOperand();
                     break;
 
+                case reg_None:  // JMP addr
+                    I8051_JmpCall(false);
+                    break;
+
                 case reg_EOL:
                     break;
 
@@ -820,6 +854,10 @@ static int I8051_DoCPUOpcode(int typ, int parm)
             }
             break;
 
+        case MOP_CALL:
+            I8051_JmpCall(true);
+            break;
+
         case OP_MOVC:
             switch (I8051_GetReg("A"))
             {
@@ -156,21 +156,34 @@ static const struct OpcdRec ARM_opcdTab[] =
 // --------------------------------------------------------------
 
 
+// returns the rotated form of an immediate value, or -1 if it can't be encoded
+static long ARM_RotImmed(uint32_t val)
+{
+    // bits 8-11 = rotate (immed8 is rotated right by 2 * this value)
+    // bits 0-7 = immed8
+    // the smallest value of rotate is chosen
+    for (int rot = 0; rot < 16; rot++)
+    {
+        // rotate left to undo the rotate right
+        uint32_t immed = rot ? (val << (rot * 2)) | (val >> (32 - rot * 2)) : val;
+        if ((immed & 0xFFFFFF00) == 0)
+        {
+            return (rot << 8) | immed;
+        }
+    }
+
+    return -1;
+}
+
+
 static long ARM_Immed(uint32_t val)
 {
     // note: can't abort assembling instruction because it may cause phase errors
 
-    if ((val & 0xFFFFFF00) == 0)
-    {
-        return (val & 0xFF);
-    }
-    else
+    long immed = ARM_RotImmed(val);
+    if (immed >= 0)
     {
-        // FIXME: need to handle shifts
-        // bit 25 (I) = 1
-        // bits 8-11 = rotate (immed8 is rotated right by 2 * this value)
-        // bits 0-7 = immed8
-        // the smallest value of rotate should be chosen
+        return immed;
     }
 
     ASMX_Error("Invalid immediate constant");
@@ -178,7 +191,53 @@ static long ARM_Immed(uint32_t val)
 }
 
 
-static bool ARM_Shifter(uint32_t *shift)
+// data processing opcodes that do the same thing as another one
+// with the immediate value inverted or negated
+static const struct
+{
+    uint8_t op;     // opcode field (bits 21-24)
+    uint8_t alt;    // opcode field of the alternate instruction
+    bool    neg;    // true if the value is negated, false if inverted
+} ARM_altOps[] =
+{
+    { 0x0, 0xE, false },    // AND / BIC
+    { 0xE, 0x0, false },
+    { 0xD, 0xF, false },    // MOV / MVN
+    { 0xF, 0xD, false },
+    { 0x5, 0x6, false },    // ADC / SBC
+    { 0x6, 0x5, false },
+    { 0x4, 0x2, true  },    // ADD / SUB
+    { 0x2, 0x4, true  },
+    { 0xA, 0xB, true  },    // CMP / CMN
+    { 0xB, 0xA, true  },
+};
+
+
+// if an immediate value can't be encoded, but it can for the alternate
+// opcode, change the opcode and return the encoded value, else -1
+static long ARM_AltImmed(int *opcode, uint32_t val)
+{
+    int op = (*opcode >> 21) & 0x0F;
+
+    for (unsigned int i = 0; i < sizeof ARM_altOps / sizeof ARM_altOps[0]; i++)
+    {
+        if (ARM_altOps[i].op == op)
+        {
+            long immed = ARM_RotImmed(ARM_altOps[i].neg ? -val : ~val);
+            if (immed >= 0)
+            {
+                *opcode = (*opcode & ~(0x0F << 21)) | (ARM_altOps[i].alt << 21);
+            }
+            return immed;
+        }
+    }
+
+    return -1;
+}
+
+
+// opcode is NULL if there is no alternate opcode for an immediate value
+static bool ARM_Shifter(uint32_t *shift, int *opcode)
 {
     int     reg1, reg2, typ;
     Str255  word;
@@ -192,10 +251,20 @@ static bool ARM_Shifter(uint32_t *shift)
     if (token == '#')
     {
         val = EXPR_Eval();
-        *shift = (1 << 25) | ARM_Immed(val);
-//  } else if (token == '=') {
-//      // I think this is where "=value" for deferred constants needs to go
-//
+        long immed = -1;
+        if (opcode)
+        {
+            immed = ARM_RotImmed(val);
+            if (immed < 0)
+            {
+                immed = ARM_AltImmed(opcode, val);
+            }
+        }
+        if (immed < 0)
+        {
+            immed = ARM_Immed(val);
+        }
+        *shift = (1 << 25) | immed;
     }
     else
     {
@@ -947,6 +1016,47 @@ static int ARM_EvalBranch(int width, int instrLen) // instrLen should be 8
 }
 
 
+// LDR Rd,=value uses MOV or MVN if the value is known and fits,
+// otherwise it loads the value from the literal pool
+static void ARM_LoadConst(int cond, int reg)
+{
+    uint32_t val = EXPR_Eval();
+    long immed = ARM_RotImmed(val);
+    uint32_t opcode = 0x03A00000;   // MOV
+    if (immed < 0)
+    {
+        immed = ARM_RotImmed(~val);
+        opcode = 0x03E00000;        // MVN
+    }
+
+    // a label's value can stop fitting as the code shrinks under --relax
+    if (RELAX_Site(evalKnown && immed >= 0))
+    {
+        INSTR_L(opcode | (cond << 28) | (reg << 12) | immed);
+        if (evalRelaxed)
+        {
+            RELAX_Note("LDR =->MOV", 4, 2);
+        }
+        return;
+    }
+
+    int ofs = LPOOL_Add(val, evalKnown) - (locPtr + 8);
+    if (pass == 2 && (ofs < -4095 || ofs > 4095))
+    {
+        ASMX_Error("Literal pool out of range");
+    }
+
+    if (ofs < 0)
+    {
+        INSTR_L(0x051F0000 | (cond << 28) | (reg << 12) | (-ofs & 0x0FFF)); // LDR Rd,[PC,#-ofs]
+    }
+    else
+    {
+        INSTR_L(0x059F0000 | (cond << 28) | (reg << 12) | (ofs & 0x0FFF));  // LDR Rd,[PC,#ofs]
+    }
+}
+
+
 static int ARM_DoCPUOpcode(int typ, int parm)
 {
     int     val, val2, i;
@@ -992,7 +1102,7 @@ static int ARM_DoCPUOpcode(int typ, int parm)
 
             if (TOKEN_Comma()) break;
 
-            if (ARM_Shifter(&mode)) break;
+            if (ARM_Shifter(&mode, &parm)) break;
 
             INSTR_L(parm | (cond << 28) | (val << 20) | (reg1 << 12) | mode);
             break;
@@ -1006,7 +1116,7 @@ static int ARM_DoCPUOpcode(int typ, int parm)
 
             if (TOKEN_Comma()) break;
 
-            if (ARM_Shifter(&mode)) break;
+            if (ARM_Shifter(&mode, &parm)) break;
 
             INSTR_L(parm | (cond << 28) | (1 << 20) | (reg1 << 16) | mode);
             break;
@@ -1027,7 +1137,7 @@ static int ARM_DoCPUOpcode(int typ, int parm)
 
             if (TOKEN_Comma()) break;
 
-            if (ARM_Shifter(&mode)) break;
+            if (ARM_Shifter(&mode, &parm)) break;
 
             INSTR_L(parm | (cond << 28) | (val << 20) | (reg2 << 16) | (reg1 << 12) | mode);
             break;
@@ -1199,6 +1309,15 @@ static int ARM_DoCPUOpcode(int typ, int parm)
 
             if (TOKEN_Comma()) break;
 
+            // LDR Rd,=value
+            oldLine = linePtr;
+            if (parm && reg2 == LDR_none && TOKEN_GetWord(word) == '=')
+            {
+                ARM_LoadConst(cond, reg1);
+                break;
+            }
+            linePtr = oldLine;
+
             if (reg2 == LDR_H || reg2 == LDR_SB || reg2 == LDR_SH)
             {
                 val = ARM_AddrMode3(&mode);
@@ -12,6 +12,7 @@ enum
     OP_Immed8,       // BKPT/SWI
     OP_Branch,       // B
     OP_BranchCC,     // Bcc
+    OP_JBranchCC,    // JBcc - Bcc, or inverted Bcc around a B if out of range
     OP_BLX,          // BLX
     OP_BL,           // BL
     OP_BX,           // BX
@@ -23,7 +24,7 @@ enum
     OP_PUSH_POP,     // PUSH/POP
     OP_Implied,      // NOP
 
-//  o_Foo = OP_LabelOp,
+    OP_POOL = OP_LabelOp, // POOL pseudo-op
 };
 
 const char regs_0_7 [] = "R0 R1 R2 R3 R4 R5 R6 R7";
@@ -39,6 +40,8 @@ enum
     REG_PC = 15,
 };
 
+bool        poolAuto;       // true to write literal pools after B/BX and before they go out of range
+
 static const struct OpcdRec THUMB_opcdTab[] =
 {
     {"ADC",   OP_TwoOp,      0x4140},
@@ -86,6 +89,23 @@ static const struct OpcdRec THUMB_opcdTab[] =
     {"BAL",   OP_BranchCC,   0xDE00},
 //  {"BNV",   OP_BranchCC,   0xDF00}, // ILLEGAL - opcode reused for SWI!
 
+    {"JBEQ",  OP_JBranchCC,  0xD000},
+    {"JBNE",  OP_JBranchCC,  0xD100},
+    {"JBCS",  OP_JBranchCC,  0xD200},
+    {"JBHS",  OP_JBranchCC,  0xD200},
+    {"JBCC",  OP_JBranchCC,  0xD300},
+    {"JBLO",  OP_JBranchCC,  0xD300},
+    {"JBMI",  OP_JBranchCC,  0xD400},
+    {"JBPL",  OP_JBranchCC,  0xD500},
+    {"JBVS",  OP_JBranchCC,  0xD600},
+    {"JBVC",  OP_JBranchCC,  0xD700},
+    {"JBHI",  OP_JBranchCC,  0xD800},
+    {"JBLS",  OP_JBranchCC,  0xD900},
+    {"JBGE",  OP_JBranchCC,  0xDA00},
+    {"JBLT",  OP_JBranchCC,  0xDB00},
+    {"JBGT",  OP_JBranchCC,  0xDC00},
+    {"JBLE",  OP_JBranchCC,  0xDD00},
+
     {"BL",    OP_BL,         0xF800},
     {"BLX",   OP_BLX,        0xE800},
 
@@ -113,6 +133,8 @@ static const struct OpcdRec THUMB_opcdTab[] =
 
     {"NOP",   OP_Implied,    0x46C0},
 
+    {"POOL",  OP_POOL,       0},
+
     {"",      OP_Illegal,    0}
 };
 
@@ -246,6 +268,22 @@ static int THUMB_EvalBranch(int width, int instrLen) // instrLen should be 4
 }
 
 
+// LDR Rd,=value loads the value from the literal pool, which must be
+// after the instruction
+static void THUMB_LoadConst(int reg)
+{
+    uint32_t val = EXPR_Eval();
+
+    int ofs = LPOOL_Add(val, evalKnown) - ((locPtr + 4) & ~3);
+    if (pass == 2 && (ofs < 0 || ofs > 1020))
+    {
+        ASMX_Error("Literal pool out of range");
+    }
+
+    INSTR_W(0x4800 | (reg << 8) | ((ofs >> 2) & 0xFF));    // LDR Rd,[PC,#ofs]
+}
+
+
 static int THUMB_DoCPUOpcode(int typ, int parm)
 {
     int     val, reg1, reg2;
@@ -253,6 +291,7 @@ static int THUMB_DoCPUOpcode(int typ, int parm)
     char    *oldLine;
     int     token;
     uint16_t regbits;
+    bool    uncond = false; // true if execution can't continue to the next instruction
 
     switch (typ)
     {
@@ -437,6 +476,7 @@ static int THUMB_DoCPUOpcode(int typ, int parm)
             {
                 INSTR_W(0xE000 | ((val >> 1) & 0x07FF));
             }
+            uncond = true;
             break;
 
         case OP_BranchCC:     // Bcc
@@ -444,6 +484,28 @@ static int THUMB_DoCPUOpcode(int typ, int parm)
             INSTR_W(parm | ((val >> 1) & 0xFF));
             break;
 
+        case OP_JBranchCC:    // JBcc
+            val = EXPR_Eval() - locPtr - 4;
+            if (evalKnown && -256 <= val && val <= 254)
+            {
+                INSTR_W(parm | ((val >> 1) & 0xFF));
+                if (evalRelaxed)
+                {
+                    RELAX_Note("Bncc+B->Bcc", 2, 1);
+                }
+            }
+            else
+            {
+                // the B is two bytes further along
+                val = val - 2;
+                if (!errFlag && ((val & 1) || val < -2048 || val > 2046))
+                {
+                    ASMX_Error("Long branch out of range");
+                }
+                INSTR_WW((parm ^ 0x0100), 0xE000 | ((val >> 1) & 0x07FF));
+            }
+            break;
+
         case OP_BLX:          // BLX
             oldLine = linePtr;
             reg1 = REG_Get(regs_0_15);
@@ -468,6 +530,7 @@ static int THUMB_DoCPUOpcode(int typ, int parm)
             if (REG_Check(reg1)) break;
 
             INSTR_W(parm | reg1 << 3);
+            uncond = true;
             break;
 
         case OP_CMP_MOV:      // CMP/MOV
@@ -530,6 +593,16 @@ static int THUMB_DoCPUOpcode(int typ, int parm)
             if (REG_Check(reg1)) break;
 
             if (TOKEN_Comma()) break;
+
+            // LDR Rd,=value
+            oldLine = linePtr;
+            if (parm && TOKEN_GetWord(word) == '=')
+            {
+                THUMB_LoadConst(reg1);
+                break;
+            }
+            linePtr = oldLine;
+
             if (TOKEN_Expect("[")) break;
 
             reg2 = REG_Get(regs_0_15);
@@ -656,6 +729,23 @@ static int THUMB_DoCPUOpcode(int typ, int parm)
             break;
     }
 
+    // the literal pool can go where execution never falls through to it
+    uint32_t first;
+    int n = LPOOL_Waiting(&first);
+    if (poolAuto && uncond)
+    {
+        LPOOL_Flush();
+    }
+    // or else after a branch around it, if waiting until after the next
+    // instruction (up to 4 bytes, one more literal, and the branch) could
+    // put the last literal out of range of the first LDR that used it
+    else if (poolAuto && n && locPtr + instrLen + 8 + n*4 > first + 2 + 1020)
+    {
+        int pad = ((locPtr + instrLen + 2) & 3) ? 2 : 0;
+        INSTR_AddW(0xE000 | (((pad + n*4 - 2) >> 1) & 0x07FF));    // B past the pool
+        LPOOL_Flush();
+    }
+
     if (locPtr & 1)
     {
         ASMX_Error("Code at non-word-aligned address");
@@ -670,9 +760,49 @@ static int THUMB_DoCPUOpcode(int typ, int parm)
 }
 
 
+static int THUMB_DoCPULabelOp(int typ, int parm, char *labl)
+{
+    (void) parm; // unused parameter
+
+    switch (typ)
+    {
+        case OP_POOL:
+            // POOL pseudo-op
+            // POOL AUTO writes literal pools after B and BX, and after a
+            // branch around them when needed to keep them in range
+            // POOL OFF only writes them at LTORG, SEG, and END
+
+            if (labl[0])
+            {
+                ASMX_Error("Label not allowed");
+            }
+
+            int reg = REG_Get("OFF AUTO");
+            if (reg < 0)
+            {
+                ASMX_IllegalOperand();
+                break;
+            }
+            poolAuto = (reg == 1);
+            break;
+
+        default:
+            return 0;
+            break;
+    }
+    return 1;
+}
+
+
+static void THUMB_PassInit(void)
+{
+    poolAuto = true;
+}
+
+
 void THUMB_AsmInit(void)
 {
-    void *p = ASMX_AddAsm(versionName, &THUMB_DoCPUOpcode, NULL, NULL);
+    void *p = ASMX_AddAsm(versionName, &THUMB_DoCPUOpcode, &THUMB_DoCPULabelOp, &THUMB_PassInit);
 
     ASMX_AddCPU(p, "THUMB", 0, END_LITTLE, ADDR_24, LIST_24, 8, 0, THUMB_opcdTab);
     ASMX_AddCPU(p, "THUMB_BE", 0, END_BIG,    ADDR_24, LIST_24, 8, 0, THUMB_opcdTab);
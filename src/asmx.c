@@ -1,5 +1,6 @@
 // asmx.c
 
+#define _GNU_SOURCE     // for fopencookie() used by --async-io
 #include "asmx.h"
 
 #define VERSION_NAME "asmx multi-assembler"
@@ -56,6 +57,26 @@ struct SegRec
 } *segTab = NULL;               // pointer to first entry in macro table
 typedef struct SegRec SegRec;
 
+struct ObjRec
+{
+    struct ObjRec       *next;      // pointer to next object output
+    FILE                *file;      // object output file
+    uint8_t             type;       // type of object file to generate, OBJ_HEX etc.
+    int                 s9type;     // type of S9 file: 9, 19, 28, or 37
+    uint32_t            binbase;    // base address for OBJ_BIN
+    uint32_t            binend;     // end address for OBJ_BIN
+    uint16_t            trslen;     // TRSDOS binary block size (default 256)
+    uint32_t            size;       // max size of object data buffer for this object type
+    uint32_t            len;        // current size of object data buffer
+    uint32_t            base;       // address of start of object data buffer
+    uint32_t            addr;       // address of next byte in object data buffer
+    uint16_t            page;       // high word of address for intel hex file
+    uint32_t            eof;        // current end of file when writing binary file
+    uint8_t             buf[TRS_BUF_MAX]; // buffer for current line of object data
+    Str255              name;       // object file name, empty for stdout
+} *objTab = NULL;               // pointer to first object output
+typedef struct ObjRec ObjRec;
+
 int             macroCondLevel;     // current IF nesting level inside a macro definition
 int             macUniqueID;        // unique ID, incremented per macro invocation
 int             macLevel;           // current macro nesting level
@@ -115,6 +136,7 @@ bool            listThisLine;       // true to force listing this line
 bool            sourceEnd;          // true when END pseudo encountered
 Str255          lastLabl;           // last label for '@' temp labels
 Str255          subrLabl;           // current SUBROUTINE label for '.' temp labels
+int             codeLabels;         // count of code labels defined, for CPUs that track state between labels
 bool            listMacFlag;        // false to suppress showing macro expansions
 bool            macLineFlag;        // true if line came from a macro
 int             linenum;            // line number in main source file
@@ -122,6 +144,9 @@ bool            expandHexFlag;      // true to expand long hex data to multiple
 bool            symtabFlag;         // true to show symbol table in listing
 bool            tempSymFlag;        // true to show temp symbols in symbol table listing
 bool            exactFlag;          // true to disable assembler-specific optimizations
+bool            relaxFlag;          // true to repeat pass 1 until instruction sizes settle (--relax)
+int             relaxIter;          // current iteration of pass 1, starting at 1
+bool            relaxChanged;       // true if a label moved in this iteration of pass 1
 
 int             condLevel;          // current IF nesting level
 char            condState[MAX_COND];// state of current nesting level
@@ -142,31 +167,61 @@ bool            xferFound;          // true if xfer addr defined w/ END
 //  Command line parameters
 Str255          cl_SrcName;         // Source file name
 Str255          cl_ListName;        // Listing file name
-Str255          cl_ObjName;         // Object file name
 bool            cl_Err;             // true for errors to screen
 bool            cl_Warn;            // true for warnings to screen
 bool            cl_List;            // true to generate listing file
 bool            cl_Obj;             // true to generate object file
-uint8_t         cl_ObjType;         // type of object file to generate:
-enum { OBJ_HEX, OBJ_S9, OBJ_BIN, OBJ_TRSDOS, OBJ_TRSCAS };  // values for cl_Obj
-uint32_t        cl_Binbase;         // base address for OBJ_BIN
-uint32_t        cl_Binend;          // end address for OBJ_BIN
-int             cl_S9type;          // type of S9 file: 9, 19, 28, or 37
-uint16_t        cl_trslen;          // TRSDOS binary block size (default 256)
+enum { OBJ_HEX, OBJ_S9, OBJ_BIN, OBJ_TRSDOS, OBJ_TRSCAS };  // values for ObjRec.type
+ObjRec          *cl_ObjOpt;         // object output being set up by format options
+int             cl_RecLen;          // data bytes per hex/S-record line (default IHEX_SIZE)
+bool            cl_Sorted;          // true to write object code sorted by address
 bool            cl_Stdout;          // true to send object file to stdout
 bool            cl_ListP1;          // true to show listing in first assembler pass
 bool            cl_edtasm;          // true to show "classic EDTASM" pass/errors messages
+bool            cl_Stats;           // true to collect performance statistics
+bool            cl_StatsText;       // true to print performance statistics to stderr
+Str255          cl_StatsName;       // performance statistics JSON file name
+Str255          cl_ProfName;        // folded-stack time profile file name
+Str255          cl_ProfBytesName;   // folded-stack object code size profile file name
+int             cl_Jobs;            // max number of variants to assemble at the same time
+bool            cl_AsyncIO;         // true to write listing and object files from a background thread
+Str255          cl_SymMapName;      // binary symbol map file name
+Str255          cl_LineTabName;     // address to source line table file name
+Str255          cl_XrefName;        // cross reference file name
+Str255          cl_SizesName;       // size report file name
+Str255          cl_SizesDiffName;   // previous size report to compare with
+long            cl_SizesLimit;      // max allowed size increase, or -1 for no limit
+Str255          cl_RelaxName;       // relaxation report file name
+const char      *errPrefix = "";    // prefix for error messages to stderr, for variants
+
+struct TextFile
+{
+    struct TextFile     *next;      // pointer to next loaded file
+    char                *text;      // contents of file
+    size_t              len;        // length of file
+    char                name[1];    // file name, storage = 1 + length
+} *textTab = NULL;              // pointer to first loaded source or include file
+typedef struct TextFile TextFile;
+
+struct TextIn
+{
+    const char          *p;         // next character to read
+    const char          *end;       // end of text
+};
+typedef struct TextIn TextIn;
 
-FILE            *source;            // source input file
-FILE            *object;            // object output file
+TextFile        *srcFile;           // source input file contents
+TextIn          source;             // source input file
 FILE            *listing;           // listing output file
 FILE            *incbin;            // binary include file
-FILE            *(include[MAX_INCLUDE]);    // include files
+TextIn          include[MAX_INCLUDE];       // include files
 Str255          incname[MAX_INCLUDE];       // include file names
+TextFile        *incfile[MAX_INCLUDE];      // include file contents, for symbol definition info
 int             incline[MAX_INCLUDE];       // include line number
 int             nInclude;           // current include file index
 
 bool            evalKnown;          // true if all operands in Eval were "known"
+bool            evalRelaxed;        // true if Eval used a forward reference that --relax made known
 
 AsmRec          *asmTab;            // list of all assemblers
 CpuRec          *cpuTab;            // list of all CPU types
@@ -196,6 +251,7 @@ enum
     OP_DL,       // DL pseudo-op
     OP_DWRE,     // reverse-endian DW
     OP_DS,       // DS pseudo-op
+    OP_FILL,     // FILL pseudo-op
     OP_HEX,      // HEX pseudo-op
     OP_FCC,      // FCC pseudo-op
     OP_ZSCII,    // ZSCII pseudo-op
@@ -205,6 +261,7 @@ enum
     OP_ALIGN_n,  // for EVEN pseudo-op
 
     OP_END,      // END pseudo-op
+    OP_LTORG,    // LTORG pseudo-op
     OP_Include,  // INCLUDE pseudo-op
 
     OP_ENDM,     // ENDM pseudo-op
@@ -274,6 +331,10 @@ static const struct OpcdRec opcdTab2[] =
     {"DS.W",      OP_DS,       2},
     {"BLKW",      OP_DS,       2},
     {"DS.L",      OP_DS,       4},
+    {"FILL",      OP_FILL,     1},
+    {"FILL.B",    OP_FILL,     1},
+    {"FILL.W",    OP_FILL,     2},
+    {"FILL.L",    OP_FILL,     4},
     {"HEX",       OP_HEX,      0},
     {"FCC",       OP_FCC,      0},
     {"ZSCII",     OP_ZSCII,    0},
@@ -281,6 +342,7 @@ static const struct OpcdRec opcdTab2[] =
     {"ASCIZ",     OP_ASCIIZ,   0},
     {"ASCIIZ",    OP_ASCIIZ,   0},
     {"END",       OP_END,      0},
+    {"LTORG",     OP_LTORG,    0},
     {"ENDM",      OP_ENDM,     0},
     {"ALIGN",     OP_ALIGN,    0},
     {"EVEN",      OP_ALIGN_n,  2},
@@ -326,2020 +388,3859 @@ static const struct OpcdRec opcdTab2[] =
 
 // --------------------------------------------------------------
 
-// multi-assembler call vectors
+// performance statistics
+//
+// Time is charged to one category at a time.  STAT_Enter() switches to a
+// new category and STAT_Leave() goes back to the previous one, so time in
+// nested calls (such as expressions evaluated by a CPU back-end) is only
+// counted in the innermost category.
 
-static int DoCPUOpcode(int typ, int parm)
+enum
 {
-    if (curAsm && curAsm -> DoCPUOpcode)
-    {
-        return curAsm -> DoCPUOpcode(typ, parm);
-    }
-    else
-    {
-        return 0;
-    }
-}
-
+    STAT_OTHER,     // directives, symbol table, everything not listed below
+    STAT_READ,      // reading source lines and expanding macro lines
+    STAT_LEX,       // splitting lines into words and tokens
+    STAT_OPCODE,    // opcode and macro name lookup
+    STAT_EXPR,      // expression evaluation
+    STAT_CPU,       // CPU back-end DoCPUOpcode/DoCPULabelOp
+    STAT_OBJECT,    // object file writing
+    STAT_LIST,      // listing file writing
+    STAT_NUM,
+
+    STAT_DEPTH = 64 // max nesting of STAT_Enter()
+};
 
-static int DoCPULabelOp(int typ, int parm, char *labl)
+const char *statCatName[STAT_NUM] =
 {
-    if (curAsm && curAsm -> DoCPULabelOp)
-    {
-        return curAsm -> DoCPULabelOp(typ, parm, labl);
-    }
-    else
-    {
-        return 0;
-    }
-}
-
+    "other", "read", "lex", "opcode", "expr", "cpu", "object", "listing"
+};
 
-static void PassInit(void)
+struct StatPass
 {
-    AsmRec *p = asmTab;
+    uint64_t    wall;               // wall clock time for pass, in ns
+    uint64_t    cpu;                // CPU time for pass, in ns
+    uint64_t    time[STAT_NUM];     // wall clock time for each category, in ns
+    uint32_t    lines;              // lines processed, including macro lines
+    uint32_t    symFind;            // symbol table lookups
+    uint32_t    symProbe;           // symbol table entries compared in lookups
+    uint32_t    macros;             // macro expansions
+    uint32_t    incFiles;           // include files opened
+    uint32_t    incLines;           // lines read from include files
+} statPass[3];                      // [0] is unused, [1] and [2] are passes 1 and 2
 
-    // for each assembler, call PassInit
-    while (p)
-    {
-        if (p -> PassInit)
-        {
-            p -> PassInit();
-        }
-        p = p -> next;
-    }
-}
+uint32_t        statSymbols;        // symbols added to symbol table
+uint64_t        statMark;           // time of last category switch
+uint64_t        statWall;           // wall clock time when this pass started
+uint64_t        statCPU;            // CPU time when this pass started
+int             statCat;            // current category
+int             statDepth;          // current nesting level of STAT_Enter()
+int             statStack[STAT_DEPTH]; // previous categories
 
 
-void *ASMX_AddAsm(const char *name, // assembler name
-             int (*DoCPUOpcode) (int typ, int parm),
-             int (*DoCPULabelOp) (int typ, int parm, char *labl),
-             void (*PassInit) (void) )
+static uint64_t STAT_Clock(clockid_t clk)
 {
-    AsmRec *p = (AsmRec *) malloc(sizeof *p + strlen(name));
-
-    strcpy(p -> name, name);
-    p -> next           = asmTab;
-    p -> DoCPUOpcode    = DoCPUOpcode;
-    p -> DoCPULabelOp   = DoCPULabelOp;
-    p -> PassInit       = PassInit;
-
-    asmTab = p;
+    struct timespec ts;
 
-    return p;
+    clock_gettime(clk, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
 }
 
-void ASMX_AddCPU(void *as,           // assembler for this CPU
-            const char *name,   // uppercase name of this CPU
-            int index,          // index number for this CPU
-            int endian,         // assembler endian
-            int addrWid,        // assembler 32-bit
-            int listWid,        // listing width
-            int wordSize,       // addressing word size in bits
-            int opts,           // option flags
-            const struct OpcdRec opcdTab[])  // assembler opcode table
-{
-    CpuRec *p = (CpuRec *) malloc(sizeof *p + strlen(name));
 
-    strcpy(p -> name, name);
-    p -> next  = cpuTab;
-    p -> as    = (AsmRec *) as;
-    p -> index = index;
-    p -> endian   = endian;
-    p -> addrWid  = addrWid;
-    p -> listWid  = listWid;
-    p -> wordSize = wordSize;
-    p -> opts     = opts;
-    p -> opcdTab  = opcdTab;
+static void STAT_Switch(int cat)
+{
+    uint64_t now = STAT_Clock(CLOCK_MONOTONIC);
 
-    cpuTab = p;
+    statPass[pass].time[statCat] += now - statMark;
+    statMark = now;
+    statCat  = cat;
 }
 
 
-static CpuRec *FindCPU(const char *cpuName)
+static void STAT_Enter(int cat)
 {
-    CpuRec *p = cpuTab;
-
-    while (p)
+    if (cl_Stats)
     {
-        if (strcmp(cpuName, p->name) == 0)
+        if (statDepth < STAT_DEPTH)
         {
-            return p;
+            statStack[statDepth] = statCat;
         }
-        p = p -> next;
+        statDepth++;
+        STAT_Switch(cat);
     }
-
-    return NULL;
 }
 
 
-static void SetWordSize(int wordSize)
+static void STAT_Leave(void)
 {
-    wordDiv = (wordSize + 7) / 8;
+    if (cl_Stats)
+    {
+        statDepth--;
+        if (statDepth < STAT_DEPTH)
+        {
+            STAT_Switch(statStack[statDepth]);
+        }
+    }
 }
 
 
-void OBJF_CodeFlush(void); // forward declaration
-// sets up curAsm and curCpu based on cpuName, returns non-zero if success
-static bool SetCPU(const char *cpuName)
+static void STAT_PassStart(void)
 {
-    CpuRec *p = FindCPU(cpuName);
-
-    if (p)
+    if (cl_Stats)
     {
-        curCPU   = p -> index;
-        curAsm   = p -> as;
-        endian   = p -> endian;
-        addrWid  = p -> addrWid;
-        listWid  = p -> listWid;
-        wordSize = p -> wordSize;
-        opcdTab  = p -> opcdTab;
-        opts     = p -> opts;
-        SetWordSize(wordSize);
-
-        OBJF_CodeFlush();    // make a visual change in the hex object file
-
-        return 1;
+        statWall  = STAT_Clock(CLOCK_MONOTONIC);
+        statCPU   = STAT_Clock(CLOCK_PROCESS_CPUTIME_ID);
+        statMark  = statWall;
+        statCat   = STAT_OTHER;
+        statDepth = 0;
     }
-
-    return 0;
 }
 
 
-int isalphanum(char c); // forward declaration
-void Uprcase(char *s); // forward declaration
-
-
-static void ASMX_AsmInit(void)
+static void STAT_PassEnd(void)
 {
-    // macro to call an assembler initialization
-#define ASSEMBLER(name) extern void name##_AsmInit(void); name##_AsmInit();
-
-    ASMX_AddCPU(ASMX_AddAsm("None", NULL, NULL, NULL),
-           "NONE", 0, END_UNKNOWN, ADDR_32, LIST_24, 8, 0, NULL);
+    if (cl_Stats)
+    {
+        // with --relax, pass 1 adds up all of its iterations, like the counts do
+        STAT_Switch(STAT_OTHER);
+        statPass[pass].wall += statMark - statWall;
+        statPass[pass].cpu  += STAT_Clock(CLOCK_PROCESS_CPUTIME_ID) - statCPU;
+    }
+}
 
-    ASSEMBLER(R1802);
-    ASSEMBLER(M6502);
-    ASSEMBLER(M68K);
-    ASSEMBLER(M6805);
-    ASSEMBLER(M6809);
-    ASSEMBLER(M68XX);
-    ASSEMBLER(M68HC16);
-    ASSEMBLER(I8048);
-    ASSEMBLER(I8051);
-    ASSEMBLER(I8085);
-    ASSEMBLER(I8008);
-    ASSEMBLER(F8);
-    ASSEMBLER(JAG);
-    ASSEMBLER(Z8);
-    ASSEMBLER(Z80);
-    ASSEMBLER(THUMB);
-    ASSEMBLER(ARM);
 
-//  strcpy(defCPU, "Z80");      // hard-coded default for testing
+// lines per second for a pass
+static double STAT_LineRate(const struct StatPass *sp)
+{
+    if (sp->wall == 0)
+    {
+        return 0;
+    }
+    return sp->lines * 1e9 / sp->wall;
+}
 
-    strcpy(line, progname);
-    Uprcase(line);
 
-    // try to find the CPU name in the executable's name
-    char *p = line + strlen(line);    // start at end of executable name
+static void STAT_Report(void)
+{
+    struct StatPass tot;
 
-    while (p > line && isalphanum(p[-1]))
+    if (!cl_Stats)
     {
-        p--;                    // skip back to last non alpha-numeric character
+        return;
     }
-    if (!isalphanum(*p)) p++;   // advance past last non alpha-numeric character
 
-    if (p[0] == 'A' && p[1] == 'S' && p[2] == 'M')
+    // totals for both passes
+    memset(&tot, 0, sizeof tot);
+    for (int i = 1; i <= 2; i++)
     {
-        p = p + 3;              // skip leading "ASM"
+        tot.wall     += statPass[i].wall;
+        tot.cpu      += statPass[i].cpu;
+        tot.lines    += statPass[i].lines;
+        tot.symFind  += statPass[i].symFind;
+        tot.symProbe += statPass[i].symProbe;
+        tot.macros   += statPass[i].macros;
+        tot.incFiles += statPass[i].incFiles;
+        tot.incLines += statPass[i].incLines;
+        for (int j = 0; j < STAT_NUM; j++)
+        {
+            tot.time[j] += statPass[i].time[j];
+        }
     }
 
-    // for each substring, try to find a matching CPU name
-    while (*p)
-    {
-        if (FindCPU(p))
+    long peakKB = 0;
+#ifndef _WIN32
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    peakKB = ru.ru_maxrss;          // ru_maxrss is in KB on Linux, bytes on macOS
+#ifdef __APPLE__
+    peakKB = peakKB / 1024;
+#endif
+#endif
+
+    if (cl_StatsText)
+    {
+        const struct StatPass *sp[3] = { &statPass[1], &statPass[2], &tot };
+
+        fprintf(stderr, "\nStatistics for %s:\n", cl_SrcName);
+        fprintf(stderr, "                        pass 1      pass 2       total\n");
+        fprintf(stderr, "    wall time (ms)");
+        for (int i = 0; i < 3; i++) fprintf(stderr, "%12.3f", sp[i]->wall / 1e6);
+        fprintf(stderr, "\n    cpu time (ms) ");
+        for (int i = 0; i < 3; i++) fprintf(stderr, "%12.3f", sp[i]->cpu / 1e6);
+        fprintf(stderr, "\n    lines         ");
+        for (int i = 0; i < 3; i++) fprintf(stderr, "%12u", sp[i]->lines);
+        fprintf(stderr, "\n    lines/sec     ");
+        for (int i = 0; i < 3; i++) fprintf(stderr, "%12.0f", STAT_LineRate(sp[i]));
+        fprintf(stderr, "\n");
+        for (int j = 0; j < STAT_NUM; j++)
         {
-            strcpy(defCPU, p);
+            fprintf(stderr, "    %-8s (ms) ", statCatName[j]);
+            for (int i = 0; i < 3; i++) fprintf(stderr, "%12.3f", sp[i]->time[j] / 1e6);
+            fprintf(stderr, "\n");
+        }
+        fprintf(stderr, "    symbol lookups");
+        for (int i = 0; i < 3; i++) fprintf(stderr, "%12u", sp[i]->symFind);
+        fprintf(stderr, "\n    symbol probes ");
+        for (int i = 0; i < 3; i++) fprintf(stderr, "%12u", sp[i]->symProbe);
+        fprintf(stderr, "\n    macro expands ");
+        for (int i = 0; i < 3; i++) fprintf(stderr, "%12u", sp[i]->macros);
+        fprintf(stderr, "\n    include files ");
+        for (int i = 0; i < 3; i++) fprintf(stderr, "%12u", sp[i]->incFiles);
+        fprintf(stderr, "\n    include lines ");
+        for (int i = 0; i < 3; i++) fprintf(stderr, "%12u", sp[i]->incLines);
+        fprintf(stderr, "\n    symbols: %u\n", statSymbols);
+        fprintf(stderr, "    peak memory: %ld KB\n", peakKB);
+    }
+
+    if (cl_StatsName[0])
+    {
+        FILE *f = fopen(cl_StatsName, "w");
+        if (f == NULL)
+        {
+            fprintf(stderr, "Unable to create statistics output file '%s'!\n", cl_StatsName);
             return;
         }
-        p++;
+
+        fprintf(f, "{\n");
+        fprintf(f, "  \"source\": \"");
+        for (const char *p = cl_SrcName; *p; p++)
+        {
+            if (*p == '"' || *p == '\\') fputc('\\', f);
+            fputc(*p, f);
+        }
+        fprintf(f, "\",\n");
+        fprintf(f, "  \"passes\": [\n");
+        for (int i = 1; i <= 2; i++)
+        {
+            const struct StatPass *sp = &statPass[i];
+
+            fprintf(f, "    {\n");
+            fprintf(f, "      \"pass\": %d,\n", i);
+            fprintf(f, "      \"wall_ms\": %.3f,\n", sp->wall / 1e6);
+            fprintf(f, "      \"cpu_ms\": %.3f,\n", sp->cpu / 1e6);
+            fprintf(f, "      \"lines\": %u,\n", sp->lines);
+            fprintf(f, "      \"lines_per_sec\": %.0f,\n", STAT_LineRate(sp));
+            fprintf(f, "      \"time_ms\": {");
+            for (int j = 0; j < STAT_NUM; j++)
+            {
+                fprintf(f, "%s\"%s\": %.3f", j ? ", " : " ", statCatName[j], sp->time[j] / 1e6);
+            }
+            fprintf(f, " },\n");
+            fprintf(f, "      \"symbol_lookups\": %u,\n", sp->symFind);
+            fprintf(f, "      \"symbol_probes\": %u,\n", sp->symProbe);
+            fprintf(f, "      \"macro_expansions\": %u,\n", sp->macros);
+            fprintf(f, "      \"include_files\": %u,\n", sp->incFiles);
+            fprintf(f, "      \"include_lines\": %u\n", sp->incLines);
+            fprintf(f, "    }%s\n", i < 2 ? "," : "");
+        }
+        fprintf(f, "  ],\n");
+        fprintf(f, "  \"wall_ms\": %.3f,\n", tot.wall / 1e6);
+        fprintf(f, "  \"cpu_ms\": %.3f,\n", tot.cpu / 1e6);
+        fprintf(f, "  \"lines_per_sec\": %.0f,\n", STAT_LineRate(&tot));
+        fprintf(f, "  \"symbols\": %u,\n", statSymbols);
+        fprintf(f, "  \"peak_rss_kb\": %ld\n", peakKB);
+        fprintf(f, "}\n");
+        fclose(f);
     }
 }
 
 
 // --------------------------------------------------------------
-// error messages
 
+// folded-stack profile of time and object code by include file and macro
+//
+// Each source line is charged to a stack made from the main source file,
+// the include files, and the macros being expanded when it was read, like
+// "main.asm;hw.inc;WRREG".  The output is one "stack value" line per stack,
+// which is the input format of flame graph tools.
 
-/*
- *  Error
- */
+enum
+{
+    PROF_HASH = 4096,   // number of hash buckets, must be a power of 2
+    PROF_KEY  = 2048,   // max length of a stack name
+};
 
-void ASMX_Error(const char *message)
+struct ProfRec
 {
-    errFlag = true;
-    errCount++;
+    struct ProfRec      *next;      // next ProfRec in hash bucket
+    uint64_t            time;       // wall clock time in ns
+    uint64_t            bytes;      // bytes of object code
+    char                name[1];    // stack name, storage = 1 + length
+};
+typedef struct ProfRec ProfRec;
 
-    char *name = cl_SrcName;
-    int line = linenum;
-    if (nInclude >= 0)
+bool            profOn;             // true if a profile is being collected
+ProfRec         *profTab[PROF_HASH];// hash table of stacks
+ProfRec         *profCur;           // stack of the line being assembled
+uint64_t        profMark;           // time when profCur was set
+uint64_t        profBytes;          // bytes of object code generated in pass 2
+uint64_t        profBytesMark;      // profBytes when profCur was set
+
+
+// append a stack frame, changing characters that are special in folded stacks
+static char *PROF_Frame(char *p, char *end, const char *name)
+{
+    if (p + 1 < end)
     {
-        name = incname[nInclude];
-        line = incline[nInclude];
+        *p++ = ';';
     }
-
-    if (pass == 2)
+    while (*name && p + 1 < end)
     {
-        listThisLine = true;
-        if (cl_List)    fprintf(listing, "%s:%d: *** Error:  %s ***\n", name, line, message);
-        if (cl_Err)     fprintf(stderr,  "%s:%d: *** Error:  %s ***\n", name, line, message);
+        char c = *name++;
+        *p++ = (c == ';' || c == ' ') ? '_' : c;
     }
-}
+    *p = 0;
 
+    return p;
+}
 
-/*
- *  ASMX_Warning
- */
 
-void ASMX_Warning(const char *message)
+static ProfRec *PROF_Find(const char *name)
 {
-    warnFlag = true;
+    uint32_t h = 0;
+    for (const char *p = name; *p; p++)
+    {
+        h = h * 31 + (uint8_t) *p;
+    }
 
-    char *name = cl_SrcName;
-    int line = linenum;
-    if (nInclude >= 0)
+    ProfRec **bucket = &profTab[h & (PROF_HASH - 1)];
+    ProfRec *p = *bucket;
+    while (p && strcmp(p -> name, name) != 0)
     {
-        name = incname[nInclude];
-        line = incline[nInclude];
+        p = p -> next;
     }
 
-    if (pass == 2 && cl_Warn)
+    if (p == NULL)
     {
-        listThisLine = true;
-        if (cl_List)    fprintf(listing, "%s:%d: *** Warning:  %s ***\n", name, line, message);
-        if (cl_Warn)    fprintf(stderr,  "%s:%d: *** Warning:  %s ***\n", name, line, message);
+        p = (ProfRec *) malloc(sizeof *p + strlen(name));
+        strcpy(p -> name, name);
+        p -> time  = 0;
+        p -> bytes = 0;
+        p -> next  = *bucket;
+        *bucket = p;
     }
+
+    return p;
 }
 
 
-// --------------------------------------------------------------
-// string utilities
+// charge everything since the last call to the previous line's stack
+static void PROF_Charge(void)
+{
+    uint64_t now = STAT_Clock(CLOCK_MONOTONIC);
 
+    if (profCur)
+    {
+        profCur -> time  += now - profMark;
+        profCur -> bytes += profBytes - profBytesMark;
+    }
+    profMark      = now;
+    profBytesMark = profBytes;
+}
 
-/*
- *  Debleft deblanks the string s from the left side
- */
 
-void Debleft(char *s)
+// called for each line, after it has been read and before it is assembled
+static void PROF_Line(void)
 {
-    char *p = s;
+    char key[PROF_KEY];
 
-    while (*p == 9 || *p == ' ')
+    if (!profOn)
     {
-        p++;
+        return;
     }
 
-    if (p != s)
+    PROF_Charge();
+
+    // the first frame doesn't get a ';' in front of it
+    char *end = key + sizeof key;
+    char *p = PROF_Frame(key, end, cl_SrcName);
+    memmove(key, key + 1, p - key);
+    p--;
+
+    for (int i = 0; i <= nInclude; i++)
     {
-        while ((*s++ = *p++)) /* copy until end of string */;
+        p = PROF_Frame(p, end, incname[i]);
+    }
+    for (int i = 0; i <= macLevel; i++)
+    {
+        if (macPtr[i])
+        {
+            p = PROF_Frame(p, end, macPtr[i] -> name);
+        }
     }
-}
 
+    profCur = PROF_Find(key);
+}
 
-/*
- *  Debright deblanks the string s from the right side
- */
 
-void Debright(char *s)
+// called at the end of each pass
+static void PROF_PassEnd(void)
 {
-    char *p = s + strlen(s);
-
-    while (p > s && *--p == ' ')
+    if (profOn)
     {
-        *p = 0;
+        PROF_Charge();
+        profCur = NULL;
     }
 }
 
 
-/*
- *  Deblank removes blanks from both ends of the string s
- */
-
-void Deblank(char *s)
+static int PROF_Compare(const void *a, const void *b)
 {
-    Debleft(s);
-    Debright(s);
+    return strcmp((*(ProfRec * const *) a) -> name, (*(ProfRec * const *) b) -> name);
 }
 
 
-/*
- *  Uprcase converts string s to upper case
- */
-
-void Uprcase(char *s)
+// write a folded-stack file with time in microseconds or object code bytes
+static void PROF_Write(const char *fname, bool bytes)
 {
-    char *p = s;
+    int n = 0;
 
-    while ((*p = toupper(*p)))
-        p++;
-}
+    for (int i = 0; i < PROF_HASH; i++)
+    {
+        for (ProfRec *p = profTab[i]; p; p = p -> next)
+        {
+            n++;
+        }
+    }
 
+    // sort the stacks so the output is always in the same order
+    ProfRec **list = (ProfRec **) malloc((n + 1) * sizeof *list);
+    n = 0;
+    for (int i = 0; i < PROF_HASH; i++)
+    {
+        for (ProfRec *p = profTab[i]; p; p = p -> next)
+        {
+            list[n++] = p;
+        }
+    }
+    qsort(list, n, sizeof *list, PROF_Compare);
 
-int ishex(char c)
-{
-    c = toupper(c);
-    return isdigit(c) || ('A' <= c && c <= 'F');
+    FILE *f = fopen(fname, "w");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Unable to create profile output file '%s'!\n", fname);
+    }
+    else
+    {
+        for (int i = 0; i < n; i++)
+        {
+            uint64_t val = bytes ? list[i] -> bytes : (list[i] -> time + 500) / 1000;
+            if (val)
+            {
+                fprintf(f, "%s %llu\n", list[i] -> name, (unsigned long long) val);
+            }
+        }
+        fclose(f);
+    }
+
+    free(list);
 }
 
 
-int isoctal(char c)
+static void PROF_Report(void)
 {
-    return ('0' <= c && c <= '7');
+    if (cl_ProfName[0])
+    {
+        PROF_Write(cl_ProfName, false);
+    }
+    if (cl_ProfBytesName[0])
+    {
+        PROF_Write(cl_ProfBytesName, true);
+    }
 }
 
 
-int isalphaul(char c)
+// --------------------------------------------------------------
+
+// address to source line table
+//
+// In pass 2, each run of object code bytes from one source line becomes a
+// row with its address, length, file, line number, and the macros being
+// expanded.  At the end, the rows are sorted by address and written to a
+// binary file, delta-encoded in blocks of LTAB_BLOCK rows, with an index
+// of the first address of each block.  A debugger can binary search the
+// index for a PC, then decode at most one block to find its source line.
+
+enum
 {
-    c = toupper(c);
-    return ('A' <= c && c <= 'Z') || c == '_';
-}
+    LTAB_VERSION    = 1,
+    LTAB_HDR_SIZE   = 64,
+    LTAB_BLOCK      = 64,   // rows per index block
+};
 
+struct LineRow
+{
+    uint32_t            addr;       // address of first byte
+    uint32_t            len;        // number of bytes
+    const TextFile      *file;      // source or include file
+    int                 line;       // line number in file
+    int                 ctx;        // macro context, index into ltabCtxTab (0 = none)
+    int                 seq;        // source line sequence number in pass 2
+};
+typedef struct LineRow LineRow;
 
-int isalphanum(char c)
+struct LineCtx
 {
-    c = toupper(c);
-    return isdigit(c) || ('A' <= c && c <= 'Z') || c == '_';
-}
+    struct LineCtx      *next;      // next macro context
+    int                 index;      // context number
+    char                name[1];    // macro names separated by ';', storage = 1 + length
+};
+typedef struct LineCtx LineCtx;
 
+LineRow         *ltabRows;          // line table rows
+int             ltabN;              // number of rows used
+int             ltabSize;           // number of rows allocated
+LineCtx         *ltabCtxTab;        // list of macro contexts
+LineCtx         *ltabCtxLast;       // most recently used macro context
+int             ltabNCtx = 1;       // number of macro contexts, including 0 = none
+uint8_t         *ltabData;          // encoded output buffer
+size_t          ltabLen;            // length of encoded output
+size_t          ltabMax;            // size of encoded output buffer
 
-static unsigned int EvalBin(const char *binStr)
+
+// returns the number of the current macro context, adding it if it is new
+static int LTAB_Context(void)
 {
-    unsigned int binVal = 0;
-    bool evalErr = false;
+    char key[PROF_KEY];
 
-    char c;
-    while ((c = *binStr++))
+    char *p = key;
+    char *end = key + sizeof key;
+    *p = 0;
+    for (int i = 0; i <= macLevel; i++)
     {
-        if (c < '0' || c > '1')
+        if (macPtr[i])
         {
-            evalErr = true;
+            p = PROF_Frame(p, end, macPtr[i] -> name);
         }
-        else
+    }
+    if (key[0] == 0)
+    {
+        return 0;
+    }
+
+    LineCtx *ctx = ltabCtxLast;
+    if (ctx == NULL || strcmp(ctx -> name, key + 1) != 0)
+    {
+        ctx = ltabCtxTab;
+        while (ctx && strcmp(ctx -> name, key + 1) != 0)
         {
-            binVal = binVal * 2 + c - '0';
+            ctx = ctx -> next;
         }
     }
 
-    if (evalErr)
+    if (ctx == NULL)
     {
-        binVal = 0;
-        ASMX_Error("Invalid binary number");
+        ctx = (LineCtx *) malloc(sizeof *ctx + strlen(key + 1));
+        strcpy(ctx -> name, key + 1);
+        ctx -> index = ltabNCtx++;
+        ctx -> next  = ltabCtxTab;
+        ltabCtxTab = ctx;
     }
 
-    return binVal;
+    ltabCtxLast = ctx;
+    return ctx -> index;
 }
 
 
-static unsigned int EvalOct(const char *octStr)
+// called in pass 2 for object code bytes generated at locPtr
+static void LTAB_Code(uint32_t len)
 {
-    unsigned int octVal = 0;
-    bool evalErr = false;
+    int seq = statPass[2].lines;
 
-    char c;
-    while ((c = *octStr++))
+    // extend the last row if this is more code from the same line
+    if (ltabN)
     {
-        if (c < '0' || c > '7')
-        {
-            evalErr = true;
-        }
-        else
+        LineRow *row = &ltabRows[ltabN - 1];
+        if (row -> seq == seq && row -> addr + row -> len == locPtr)
         {
-            octVal = octVal * 8 + c - '0';
+            row -> len = row -> len + len;
+            return;
         }
     }
 
-    if (evalErr)
+    if (ltabN == ltabSize)
     {
-        octVal = 0;
-        ASMX_Error("Invalid octal number");
+        ltabSize = ltabSize ? ltabSize * 2 : 4096;
+        ltabRows = (LineRow *) realloc(ltabRows, ltabSize * sizeof *ltabRows);
     }
 
-    return octVal;
+    LineRow *row = &ltabRows[ltabN++];
+    row -> addr = locPtr;
+    row -> len  = len;
+    row -> file = srcFile;
+    row -> line = linenum;
+    if (nInclude >= 0)
+    {
+        row -> file = incfile[nInclude];
+        row -> line = incline[nInclude];
+    }
+    row -> ctx  = LTAB_Context();
+    row -> seq  = seq;
 }
 
 
-static unsigned int EvalSplitOct(const char *octStr)
+static int LTAB_Compare(const void *a, const void *b)
 {
-    unsigned int octVal = 0;
-    int len = strlen(octStr);
-    bool evalErr = len > 6;
-
-    // xxxyyyA format was used by Heath to represent
-    // octal as separate octal bytes xxx and yyy
-    // as would be seen on an H8 front panel
-    // 377377A represents 0xFFFF
+    const LineRow *p = (const LineRow *) a;
+    const LineRow *q = (const LineRow *) b;
 
-    char c;
-    int digit = 0;
-    while ((c = *octStr++))
+    if (p -> addr != q -> addr)
     {
-        if (c < '0' || c > '7' || (c > '3' && (len - digit) % 3 == 0))
-        {
-            evalErr = true;
-        }
-        else
-        {
-            if (digit == len - 3)
-            {
-                octVal = octVal * 4 + c - '0';
-            }
-            else
-            {
-                octVal = octVal * 8 + c - '0';
-            }
-        }
-        digit++;
+        return (p -> addr < q -> addr) ? -1 : 1;
     }
+    return p -> seq - q -> seq;
+}
 
-    if (evalErr)
+
+static void LTAB_Byte(int byte)
+{
+    if (ltabLen == ltabMax)
     {
-        octVal = 0;
-        ASMX_Error("Invalid split-octal number");
+        ltabMax  = ltabMax ? ltabMax * 2 : 65536;
+        ltabData = (uint8_t *) realloc(ltabData, ltabMax);
     }
-
-    return octVal;
+    ltabData[ltabLen++] = byte;
 }
 
 
-static unsigned int EvalDec(const char *decStr)
+static void LTAB_Put32(uint32_t val)
 {
-    unsigned int decVal = 0;
-    bool evalErr = false;
+    LTAB_Byte(val);
+    LTAB_Byte(val >> 8);
+    LTAB_Byte(val >> 16);
+    LTAB_Byte(val >> 24);
+}
 
-    char c;
-    while ((c = *decStr++))
+
+// unsigned LEB128
+static void LTAB_PutU(uint64_t val)
+{
+    while (val >= 0x80)
     {
-        if (!isdigit(c))
-        {
-            evalErr = true;
-        }
-        else
-        {
-            decVal = decVal * 10 + c - '0';
-        }
+        LTAB_Byte((val & 0x7F) | 0x80);
+        val = val >> 7;
     }
+    LTAB_Byte(val);
+}
 
-    if (evalErr)
+
+// signed LEB128
+static void LTAB_PutS(int64_t val)
+{
+    bool more = true;
+
+    while (more)
     {
-        decVal = 0;
-        ASMX_Error("Invalid decimal number");
+        int byte = val & 0x7F;
+        val = val >> 7;
+        more = !((val == 0 && !(byte & 0x40)) || (val == -1 && (byte & 0x40)));
+        LTAB_Byte(more ? byte | 0x80 : byte);
     }
+}
 
-    return decVal;
+
+static void LTAB_Patch32(size_t ofs, uint32_t val)
+{
+    ltabData[ofs + 0] = val;
+    ltabData[ofs + 1] = val >> 8;
+    ltabData[ofs + 2] = val >> 16;
+    ltabData[ofs + 3] = val >> 24;
 }
 
 
-static int Hex2Dec(int c)
+static void LTAB_Align(void)
 {
-    c = toupper(c);
-    if (c > '9')
+    while (ltabLen & 3)
     {
-        return c - 'A' + 10;
+        LTAB_Byte(0);
     }
-    return c - '0';
 }
 
 
-static unsigned int EvalHex(const char *hexStr)
+static bool LTAB_Write(void)
 {
-    unsigned int hexVal = 0;
-    bool evalErr = false;
+    qsort(ltabRows, ltabN, sizeof *ltabRows, LTAB_Compare);
 
-    char c;
-    while ((c = *hexStr++))
+    int nFiles = 0;
+    for (TextFile *f = textTab; f; f = f -> next)
     {
-        if (!ishex(c))
-        {
-            evalErr = true;
-        }
-        else
-        {
-            hexVal = hexVal * 16 + Hex2Dec(c);
-        }
+        nFiles++;
     }
+    int nBlocks = (ltabN + LTAB_BLOCK - 1) / LTAB_BLOCK;
 
-    if (evalErr)
+    // header, filled in below
+    ltabLen = 0;
+    for (int i = 0; i < LTAB_HDR_SIZE; i++)
     {
-        hexVal = 0;
-        ASMX_Error("Invalid hexadecimal number");
+        LTAB_Byte(0);
     }
+    memcpy(ltabData, "ASMXLIN", 8);
+    LTAB_Patch32( 8, LTAB_VERSION);
+    LTAB_Patch32(12, ltabN);
+    LTAB_Patch32(16, nBlocks);
+    LTAB_Patch32(20, LTAB_BLOCK);
+    LTAB_Patch32(28, nFiles);
+    LTAB_Patch32(36, ltabNCtx);
 
-    return hexVal;
-}
+    // block index, filled in while encoding the rows
+    size_t indexOff = ltabLen;
+    for (int i = 0; i < nBlocks * 2; i++)
+    {
+        LTAB_Put32(0);
+    }
 
+    // file table and macro context table, as string table offsets
+    size_t fileOff = ltabLen;
+    uint32_t str = 0;
+    for (TextFile *f = textTab; f; f = f -> next)
+    {
+        LTAB_Put32(str);
+        str = str + strlen(f -> name) + 1;
+    }
 
-static unsigned int EvalNum(char *word)
-{
-    // handle C-style 0xnnnn hexadecimal constants
-    if(word[0] == '0')
+    const char **ctxName = (const char **) malloc((ltabNCtx + 1) * sizeof *ctxName);
+    ctxName[0] = "";
+    for (LineCtx *ctx = ltabCtxTab; ctx; ctx = ctx -> next)
     {
-        if (toupper(word[1]) == 'X')
-        {
-            return EvalHex(word+2);
-        }
-        // return EvalOct(word);    // 0nnn octal constants are in less demand, though
+        ctxName[ctx -> index] = ctx -> name;
+    }
+    size_t ctxOff = ltabLen;
+    for (int i = 0; i < ltabNCtx; i++)
+    {
+        LTAB_Put32(str);
+        str = str + strlen(ctxName[i]) + 1;
     }
 
-    unsigned int val = strlen(word) - 1;
-    switch (word[val])
+    // rows, with each block starting from address 0 and line 0
+    size_t dataOff = ltabLen;
+    const TextFile *lastFile = NULL;
+    int fileNum = 0;
+    int64_t prevEnd = 0;
+    int prevLine = 0;
+    for (int i = 0; i < ltabN; i++)
     {
-        case 'A': // nnnnnnA format used by Heath
-            word[val] = 0;
-            val = EvalSplitOct(word);
-            break;
+        LineRow *row = &ltabRows[i];
 
-        case 'B':
-            word[val] = 0;
-            val = EvalBin(word);
-            break;
+        if (i % LTAB_BLOCK == 0)
+        {
+            LTAB_Patch32(indexOff + (i / LTAB_BLOCK) * 8,     row -> addr);
+            LTAB_Patch32(indexOff + (i / LTAB_BLOCK) * 8 + 4, ltabLen - dataOff);
+            prevEnd  = 0;
+            prevLine = 0;
+        }
 
-        case 'O':
-        case 'Q':
-            word[val] = 0;
-            val = EvalOct(word);
-            break;
+        if (row -> file != lastFile)
+        {
+            lastFile = row -> file;
+            fileNum = 0;
+            for (TextFile *f = textTab; f && f != lastFile; f = f -> next)
+            {
+                fileNum++;
+            }
+        }
 
-        case 'D':
-            word[val] = 0;
-            val = EvalDec(word);
-            break;
+        LTAB_PutS((int64_t) row -> addr - prevEnd);
+        LTAB_PutU(row -> len);
+        LTAB_PutU(fileNum);
+        LTAB_PutS(row -> line - prevLine);
+        LTAB_PutU(row -> ctx);
 
-        case 'H':
-            word[val] = 0;
-            val = EvalHex(word);
-            break;
+        prevEnd  = (int64_t) row -> addr + row -> len;
+        prevLine = row -> line;
+    }
+    size_t dataSize = ltabLen - dataOff;
+    LTAB_Align();
 
-        default:
-            val = EvalDec(word);
-            break;
+    // string table
+    size_t strOff = ltabLen;
+    for (TextFile *f = textTab; f; f = f -> next)
+    {
+        for (const char *p = f -> name; *p; p++)
+        {
+            LTAB_Byte(*p);
+        }
+        LTAB_Byte(0);
+    }
+    for (int i = 0; i < ltabNCtx; i++)
+    {
+        for (const char *p = ctxName[i]; *p; p++)
+        {
+            LTAB_Byte(*p);
+        }
+        LTAB_Byte(0);
     }
+    size_t strSize = ltabLen - strOff;
+    LTAB_Align();
 
-    return val;
+    LTAB_Patch32(24, indexOff);
+    LTAB_Patch32(32, fileOff);
+    LTAB_Patch32(40, ctxOff);
+    LTAB_Patch32(44, dataOff);
+    LTAB_Patch32(48, dataSize);
+    LTAB_Patch32(52, strOff);
+    LTAB_Patch32(56, strSize);
+
+    free(ctxName);
+
+    bool ok = false;
+    FILE *f = fopen(cl_LineTabName, "wb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Unable to create line table file '%s'!\n", cl_LineTabName);
+    }
+    else
+    {
+        ok = (fwrite(ltabData, 1, ltabLen, f) == ltabLen);
+        ok = (fclose(f) == 0) && ok;
+        if (!ok)
+        {
+            fprintf(stderr, "Error writing line table file '%s': %s\n", cl_LineTabName, strerror(errno));
+        }
+    }
+
+    return ok;
 }
 
 
 // --------------------------------------------------------------
-// listing hex output routines
 
-char *LIST_Str(char *l, const char *s)
+// size report
+//
+// In pass 2, object code bytes are counted by the global label they
+// follow, by segment, and by source or include file.  The report lists
+// each one sorted by size, one per line as "kind bytes change name", and
+// can show the change from a previous report for catching size increases.
+
+enum
 {
-    // copy string to line
-    while (*s) *l++ = *s++;
+    SIZE_HASH = 4096,   // number of hash buckets, must be a power of 2
+};
 
-    return l;
-}
+enum { SIZE_TOTAL, SIZE_SEGMENT, SIZE_FILE, SIZE_LABEL, SIZE_KINDS };  // values for SizeRec.kind
 
+static const char *sizeKind[SIZE_KINDS] = { "total", "segment", "file", "label" };
 
-char *LIST_Byte(char *p, uint8_t b)
+struct SizeRec
 {
-    char s[16]; // with extra space for just in case
+    struct SizeRec      *next;      // next SizeRec in hash bucket
+    int                 kind;       // SIZE_TOTAL etc.
+    uint64_t            bytes;      // bytes of object code
+    uint64_t            old;        // bytes in previous report
+    char                name[1];    // label, segment, or file name, storage = 1 + length
+};
+typedef struct SizeRec SizeRec;
 
-    sprintf(s, "%.2X", b);
-    return LIST_Str(p, s);
-}
+SizeRec         *sizeTab[SIZE_HASH];// hash table of labels, segments, and files
+int             sizeCount;          // number of SizeRecs
+SizeRec         *sizeLabel;         // record for current label
+SizeRec         *sizeSeg;           // record for current segment
+SegRec          *sizeSegRec;        // segment of sizeSeg
+SizeRec         *sizeFile;          // record for current file
+const char      *sizeFileName;      // file name of sizeFile
 
 
-char *LIST_Word(char *p, uint16_t w)
+static SizeRec *SIZE_Find(int kind, const char *name)
 {
-    char s[16]; // with extra space for just in case
+    if (*name == 0)
+    {
+        name = "(none)";
+    }
 
-    sprintf(s, "%.4X", w);
-    return LIST_Str(p, s);
-}
+    uint32_t h = kind;
+    for (const char *p = name; *p; p++)
+    {
+        h = h * 31 + (uint8_t) *p;
+    }
 
+    SizeRec **bucket = &sizeTab[h & (SIZE_HASH - 1)];
+    SizeRec *p = *bucket;
+    while (p && (p -> kind != kind || strcmp(p -> name, name) != 0))
+    {
+        p = p -> next;
+    }
 
-char *ListLong24(char *p, uint32_t l)
-{
-    char s[16]; // with extra space for just in case
+    if (p == NULL)
+    {
+        p = (SizeRec *) malloc(sizeof *p + strlen(name));
+        strcpy(p -> name, name);
+        p -> kind  = kind;
+        p -> bytes = 0;
+        p -> old   = 0;
+        p -> next  = *bucket;
+        *bucket = p;
+        sizeCount++;
+    }
 
-    sprintf(s, "%.6X", l & 0xFFFFFF);
-    return LIST_Str(p, s);
+    return p;
 }
 
 
-char *LIST_Long(char *p, uint32_t l)
+// called in pass 2 for object code bytes
+static void SIZE_Code(uint32_t len)
 {
-    char s[16]; // with extra space for just in case
+    // only look up the records again when they change
+    if (sizeLabel == NULL || strcmp(sizeLabel -> name, lastLabl[0] ? lastLabl : "(none)") != 0)
+    {
+        sizeLabel = SIZE_Find(SIZE_LABEL, lastLabl);
+    }
+    if (sizeSeg == NULL || sizeSegRec != curSeg)
+    {
+        sizeSeg = SIZE_Find(SIZE_SEGMENT, curSeg -> name);
+        sizeSegRec = curSeg;
+    }
+    const char *fname = (nInclude >= 0) ? incname[nInclude] : cl_SrcName;
+    if (sizeFile == NULL || sizeFileName != fname || strcmp(sizeFile -> name, fname) != 0)
+    {
+        sizeFile = SIZE_Find(SIZE_FILE, fname);
+        sizeFileName = fname;
+    }
 
-    sprintf(s, "%.8X", l);
-    return LIST_Str(p, s);
+    sizeLabel -> bytes += len;
+    sizeSeg -> bytes += len;
+    sizeFile -> bytes += len;
 }
 
 
-char *LIST_Addr(char *p, uint32_t addr)
+// load a previous size report for comparison
+static bool SIZE_ReadOld(const char *fname)
 {
-    switch (addrWid)
+    char s[1024];
+    char kind[16];
+    char change[32];
+    unsigned long long bytes;
+    int pos;
+
+    FILE *f = fopen(fname, "r");
+    if (f == NULL)
     {
-        default:
-        case ADDR_16:
-            p = LIST_Word(p, addr);
-            break;
+        fprintf(stderr, "Unable to open previous size report '%s'!\n", fname);
+        return false;
+    }
 
-        case ADDR_24:
-            p = ListLong24(p, addr);
-            break;
+    while (fgets(s, sizeof s, f))
+    {
+        if (s[0] != ';' && sscanf(s, "%15s %llu %31s %n", kind, &bytes, change, &pos) == 3)
+        {
+            char *name = s + pos;
+            name[strcspn(name, "\r\n")] = 0;
 
-        case ADDR_32: // you need listWid == LIST_24 with this too
-            p = LIST_Long(p, addr);
-            break;
-    };
+            for (int k = 0; k < SIZE_KINDS; k++)
+            {
+                if (strcmp(kind, sizeKind[k]) == 0)
+                {
+                    SIZE_Find(k, name) -> old = bytes;
+                }
+            }
+        }
+    }
+    fclose(f);
 
-    return p;
+    return true;
 }
 
-char *LIST_Loc(uint32_t addr)
+
+static int SIZE_Compare(const void *a, const void *b)
 {
-    char *p = LIST_Addr(listLine, addr);
+    const SizeRec *p = *(SizeRec * const *) a;
+    const SizeRec *q = *(SizeRec * const *) b;
 
-    *p++ = ' ';
-    if (listWid == LIST_24 && addrWid == ADDR_16)
+    if (p -> kind != q -> kind)
     {
-        *p++ = ' ';
+        return p -> kind - q -> kind;
     }
-
-    return p;
+    if (p -> bytes != q -> bytes)
+    {
+        return (p -> bytes > q -> bytes) ? -1 : 1;
+    }
+    return strcmp(p -> name, q -> name);
 }
 
-// --------------------------------------------------------------
-// ZSCII conversion routines
-
-uint8_t zStr[MAX_BYTSTR];   // output data buffer
-int     zLen;               // length of output data
-int     zOfs, zPos;         // current output offset (in bytes) and bit position
-int     zShift;             // current shift lock status (0, 1, 2)
-const char zSpecial[] = "0123456789.,!?_#'\"/\\<-:()"; // special chars table
-
 
-static void InitZSCII(void)
+static bool SIZE_Write(void)
 {
-    zOfs = 0;
-    zPos = 0;
-    zLen = 0;
-    zShift = 0;
-}
-
+    // the total is the sum of the segments
+    SizeRec *total = SIZE_Find(SIZE_TOTAL, "(all)");
+    total -> bytes = 0;
+    for (int i = 0; i < SIZE_HASH; i++)
+    {
+        for (SizeRec *p = sizeTab[i]; p; p = p -> next)
+        {
+            if (p -> kind == SIZE_SEGMENT)
+            {
+                total -> bytes += p -> bytes;
+            }
+        }
+    }
 
-static void PutZSCII(char nib)
-{
-    nib = nib & 0x1F;
+    bool diff = (cl_SizesDiffName[0] != 0);
+    if (diff && !SIZE_ReadOld(cl_SizesDiffName))
+    {
+        return false;
+    }
 
-    // is it time to start a new word?
-    if (zPos == 3)
+    SizeRec **list = (SizeRec **) malloc((sizeCount + 1) * sizeof *list);
+    int n = 0;
+    for (int i = 0; i < SIZE_HASH; i++)
     {
-        // check for overflow
-        if (zOfs >= MAX_BYTSTR)
+        for (SizeRec *p = sizeTab[i]; p; p = p -> next)
         {
-            if (!errFlag) ASMX_Error("ZSCII string length overflow");
-            return;
+            list[n++] = p;
         }
-        zOfs = zOfs + 2;
-        zPos = 0;
     }
+    qsort(list, n, sizeof *list, SIZE_Compare);
 
-    switch (zPos)
+    bool ok = false;
+    FILE *f = fopen(cl_SizesName, "w");
+    if (f == NULL)
     {
-        case 0:
-            zStr[zOfs] = nib << 2;
-            break;
+        fprintf(stderr, "Unable to create size report file '%s'!\n", cl_SizesName);
+    }
+    else
+    {
+        fprintf(f, "; asmx size report for %s\n", cl_SrcName);
+        if (diff)
+        {
+            fprintf(f, "; change is from %s\n", cl_SizesDiffName);
+        }
+        fprintf(f, "; kind      bytes   change  name\n");
 
-        case 1:
-            zStr[zOfs] |= nib >> 3;
-            zStr[zOfs+1] = nib << 5;
-            break;
+        for (int i = 0; i < n; i++)
+        {
+            SizeRec *p = list[i];
+            Str255 change = "-";
+            if (diff)
+            {
+                snprintf(change, sizeof change, "%+lld", (long long) (p -> bytes - p -> old));
+            }
+            if (p -> bytes || p -> old)
+            {
+                fprintf(f, "%-8s %8llu %8s  %s\n", sizeKind[p -> kind],
+                        (unsigned long long) p -> bytes, change, p -> name);
+            }
+        }
 
-        case 2:
-            zStr[zOfs+1] |= nib;
-            break;
+        ok = !ferror(f);
+        ok = (fclose(f) == 0) && ok;
+        if (!ok)
+        {
+            fprintf(stderr, "Error writing size report file '%s': %s\n", cl_SizesName, strerror(errno));
+        }
+    }
 
-        default:    // this shouldn't happen!
-            break;
+    if (diff)
+    {
+        long long change = (long long) (total -> bytes - total -> old);
+        fprintf(stderr, "%sSize change from '%s': %+lld bytes\n", errPrefix, cl_SizesDiffName, change);
+        if (cl_SizesLimit >= 0 && change > cl_SizesLimit)
+        {
+            fprintf(stderr, "%sSize increase of %lld bytes is over the --sizes-limit of %ld\n",
+                    errPrefix, change, cl_SizesLimit);
+            ok = false;
+        }
     }
 
-    zPos++;
+    free(list);
+
+    return ok;
 }
 
 
-static void PutZSCIIShift(char shift, char nshift)
-{
-    int lock = 0;                   // only do a temp shift if next shift is different
+// --------------------------------------------------------------
 
-    if (shift == nshift) lock = 2;  // generate shift lock if next shift is same
+// multi-assembler call vectors
 
-    switch ((shift - zShift + 3) % 3)
+static int DoCPUOpcode(int typ, int parm)
+{
+    if (curAsm && curAsm -> DoCPUOpcode)
     {
-        case 0: // no shift
-            break;
-
-        case 1: // shift forward
-            PutZSCII(0x02 + lock);
-            break;
-
-        case 2: // shift backwards
-            PutZSCII(0x03 + lock);
-            break;
+        STAT_Enter(STAT_CPU);
+        int result = curAsm -> DoCPUOpcode(typ, parm);
+        STAT_Leave();
+        return result;
+    }
+    else
+    {
+        return 0;
     }
-
-    if (lock) zShift = shift;       // update shift lock state
 }
 
 
-static void EndZSCII(void)
+static int DoCPULabelOp(int typ, int parm, char *labl)
 {
-    // pad final word with shift nibbles
-    while (zPos != 3)
+    if (curAsm && curAsm -> DoCPULabelOp)
     {
-        PutZSCII(0x05);
+        STAT_Enter(STAT_CPU);
+        int result = curAsm -> DoCPULabelOp(typ, parm, labl);
+        STAT_Leave();
+        return result;
+    }
+    else
+    {
+        return 0;
     }
-
-    // set high bit in final word as end-of-text marker
-    zStr[zOfs] |= 0x80;
-
-    zOfs = zOfs + 2;
 }
 
 
-static int GetZSCIIShift(char ch)
+static void PassInit(void)
 {
-    if (ch == ' ')  return -2;
-    if (ch == '\n') return -1;
-    if ('a' <= ch && ch <= 'z') return 0;
-    if ('A' <= ch && ch <= 'Z') return 1;
-    return 2;
+    AsmRec *p = asmTab;
+
+    // for each assembler, call PassInit
+    while (p)
+    {
+        if (p -> PassInit)
+        {
+            p -> PassInit();
+        }
+        p = p -> next;
+    }
 }
 
 
-static void ConvertZSCII(void)
+void *ASMX_AddAsm(const char *name, // assembler name
+             int (*DoCPUOpcode) (int typ, int parm),
+             int (*DoCPULabelOp) (int typ, int parm, char *labl),
+             void (*PassInit) (void) )
 {
-    //  input data is in bytStr[]
-    //  input data length is instrLen
-
-    char    *p;                         // pointer for looking up special chars
+    AsmRec *p = (AsmRec *) malloc(sizeof *p + strlen(name));
 
-    InitZSCII();
+    strcpy(p -> name, name);
+    p -> next           = asmTab;
+    p -> DoCPUOpcode    = DoCPUOpcode;
+    p -> DoCPULabelOp   = DoCPULabelOp;
+    p -> PassInit       = PassInit;
 
-    int inpos = 0;                      // input position
-    while (inpos < instrLen)
-    {
-        // get current char and shift
-        char ch = bytStr[inpos];        // current input byte
-        int shift = GetZSCIIShift(ch);  // current shift state
-        int nshift = shift;             // next shift state
+    asmTab = p;
 
-        // determine next char's shift (skipping blanks and newlines, stopping at end of data)
-        int i = inpos + 1;
-        while (i < instrLen && (nshift = GetZSCIIShift(bytStr[i])) < 0) i++;
-        if (i >= instrLen) nshift = zShift;    // if end of data, use current shift as "next" shift
+    return p;
+}
 
-        switch (shift)
-        {
-            case 0: // alpha lower case
-            case 1: // alpha upper case
-                PutZSCIIShift(shift, nshift);
-                PutZSCII(ch - 'A' + 6);
-                break;
+void ASMX_AddCPU(void *as,           // assembler for this CPU
+            const char *name,   // uppercase name of this CPU
+            int index,          // index number for this CPU
+            int endian,         // assembler endian
+            int addrWid,        // assembler 32-bit
+            int listWid,        // listing width
+            int wordSize,       // addressing word size in bits
+            int opts,           // option flags
+            const struct OpcdRec opcdTab[])  // assembler opcode table
+{
+    CpuRec *p = (CpuRec *) malloc(sizeof *p + strlen(name));
 
-            case 2: // non-alpha
-                if ((p = strchr(zSpecial, ch)))
-                {
-                    // numeric and special chars
-                    PutZSCIIShift(shift, nshift);
-                    PutZSCII(p - zSpecial + 7);
-                }
-                else
-                {
-                    // extended char
-                    PutZSCIIShift(shift, nshift);
-                    PutZSCII(0x06);
-                    PutZSCII(ch >> 5);
-                    PutZSCII(ch);
-                }
-                break;
-
-            default: // blank and newline
-                PutZSCII(shift + 2);
-                break;
-        }
-
-        inpos++;
-    }
-
-    EndZSCII();
+    strcpy(p -> name, name);
+    p -> next  = cpuTab;
+    p -> as    = (AsmRec *) as;
+    p -> index = index;
+    p -> endian   = endian;
+    p -> addrWid  = addrWid;
+    p -> listWid  = listWid;
+    p -> wordSize = wordSize;
+    p -> opts     = opts;
+    p -> opcdTab  = opcdTab;
 
-    memcpy(bytStr, zStr, zOfs);
-    instrLen = zOfs;
+    cpuTab = p;
 }
 
 
-// --------------------------------------------------------------
-// token handling
-
-// returns 0 for end-of-line, -1 for alpha-numeric, else char value for non-alphanumeric
-// converts the word to uppercase, too
-int TOKEN_GetWord(char *word)
+static CpuRec *FindCPU(const char *cpuName)
 {
-    word[0] = 0;
-
-    // skip initial whitespace
-    char c = *linePtr;
-    while (c == 12 || c == '\t' || c == ' ')
-    {
-        c = *++linePtr;
-    }
+    CpuRec *p = cpuTab;
 
-    // skip comments
-    if (c == ';')
+    while (p)
     {
-        while (c)
+        if (strcmp(cpuName, p->name) == 0)
         {
-            c = *++linePtr;
+            return p;
         }
+        p = p -> next;
     }
 
-    // test for end of line
-    if (c)
-    {
-        // test for alphanumeric token
-#if 1
-        if (isalphanum(c) ||
-                (
-                    (((opts & OPT_DOLLARSYM) && c == '$') || ((opts & OPT_ATSYM) && c == '@'))
-                    && ((isalphanum(linePtr[1]) ||
-                         linePtr[1]=='$' ||
-                         ((opts & OPT_ATSYM) && linePtr[1]=='@'))
-                       )
-                ))
-
-#else
-
-#ifdef DOLLAR_SYM
-        if (isalphanum(c) || (c == '$' && (isalphanum(linePtr[1]) || linePtr[1]=='$')))
-#else
-        if (isalphanum(c))
-#endif
+    return NULL;
+}
 
-#endif
-        {
-            while (isalphanum(c) || c == '$' || ((opts & OPT_ATSYM) && c == '@'))
-            {
-                *word++ = toupper(c);
-                c = *++linePtr;
-            }
-            *word = 0;
-            return -1;
-        }
-        else
-        {
-            word[0] = c;
-            word[1] = 0;
-            linePtr++;
-            return c;
-        }
-    }
 
-    return 0;
+static void SetWordSize(int wordSize)
+{
+    wordDiv = (wordSize + 7) / 8;
 }
 
 
-// same as GetWord, except it allows '.' chars in alphanumerics and ":=" as a token
-int GetOpcode(char *word)
+void OBJF_CodeFlush(void); // forward declaration
+// sets up curAsm and curCpu based on cpuName, returns non-zero if success
+static bool SetCPU(const char *cpuName)
 {
-    word[0] = 0;
+    CpuRec *p = FindCPU(cpuName);
 
-    // skip initial whitespace
-    char c = *linePtr;
-    while (c == 12 || c == '\t' || c == ' ')
+    if (p)
     {
-        c = *++linePtr;
-    }
+        curCPU   = p -> index;
+        curAsm   = p -> as;
+        endian   = p -> endian;
+        addrWid  = p -> addrWid;
+        listWid  = p -> listWid;
+        wordSize = p -> wordSize;
+        opcdTab  = p -> opcdTab;
+        opts     = p -> opts;
+        SetWordSize(wordSize);
 
-    // skip comments
-    if (c == ';')
-    {
-        while (c)
-        {
-            c = *++linePtr;
-        }
-    }
+        OBJF_CodeFlush();    // make a visual change in the hex object file
 
-    // test for ":="
-    if (c == ':' && linePtr[1] == '=')
-    {
-        word[0] = ':';
-        word[1] = '=';
-        word[2] = 0;
-        linePtr = linePtr + 2;
-        return -1;
-    }
-    else if (c)
-    {
-        // test for end of line
-        // test for alphanumeric token
-        if (isalphanum(c) || c=='.')
-        {
-            while (isalphanum(c) || c=='.')
-            {
-                *word++ = toupper(c);
-                c = *++linePtr;
-            }
-            *word = 0;
-            return -1;
-        }
-        else
-        {
-            word[0] = c;
-            word[1] = 0;
-            linePtr++;
-            return c;
-        }
+        return 1;
     }
 
     return 0;
 }
 
 
-void GetFName(char *word)
+int isalphanum(char c); // forward declaration
+void Uprcase(char *s); // forward declaration
+
+
+static void ASMX_AsmInit(void)
 {
-    // skip leading whitespace
-    while (*linePtr == ' ' || *linePtr == '\t')
-    {
-        linePtr++;
-    }
-    char *oldLine = word;
+    // macro to call an assembler initialization
+#define ASSEMBLER(name) extern void name##_AsmInit(void); name##_AsmInit();
 
-    // check for quote at start of file name
-    char quote = 0;
-    if (*linePtr == '"' || *linePtr == '\'')
+    ASMX_AddCPU(ASMX_AddAsm("None", NULL, NULL, NULL),
+           "NONE", 0, END_UNKNOWN, ADDR_32, LIST_24, 8, 0, NULL);
+
+    ASSEMBLER(R1802);
+    ASSEMBLER(M6502);
+    ASSEMBLER(M68K);
+    ASSEMBLER(M6805);
+    ASSEMBLER(M6809);
+    ASSEMBLER(M68XX);
+    ASSEMBLER(M68HC16);
+    ASSEMBLER(I8048);
+    ASSEMBLER(I8051);
+    ASSEMBLER(I8085);
+    ASSEMBLER(I8008);
+    ASSEMBLER(F8);
+    ASSEMBLER(JAG);
+    ASSEMBLER(Z8);
+    ASSEMBLER(Z80);
+    ASSEMBLER(THUMB);
+    ASSEMBLER(ARM);
+
+//  strcpy(defCPU, "Z80");      // hard-coded default for testing
+
+    strcpy(line, progname);
+    Uprcase(line);
+
+    // try to find the CPU name in the executable's name
+    char *p = line + strlen(line);    // start at end of executable name
+
+    while (p > line && isalphanum(p[-1]))
     {
-        quote = *linePtr++;
+        p--;                    // skip back to last non alpha-numeric character
     }
+    if (!isalphanum(*p)) p++;   // advance past last non alpha-numeric character
 
-    // continue reading until quote or whitespace or EOL
-    while (*linePtr != 0 && *linePtr != quote &&
-            (quote || (*linePtr != ' ' && *linePtr != '\t')))
+    if (p[0] == 'A' && p[1] == 'S' && p[2] == 'M')
     {
-        char ch = *linePtr++;
-        if (ch == '\\' && *linePtr != 0)
-        {
-            ch = *linePtr++;
-        }
-        *oldLine++ = ch;
+        p = p + 3;              // skip leading "ASM"
     }
-    *oldLine++ = 0;
 
-    // if looking for quote, error on end quote
-    if (quote)
+    // for each substring, try to find a matching CPU name
+    while (*p)
     {
-        if (*linePtr == quote)
-        {
-            linePtr++;
-        }
-        else
+        if (FindCPU(p))
         {
-            ASMX_Error("Missing close quote");
+            strcpy(defCPU, p);
+            return;
         }
+        p++;
     }
 }
 
 
-bool TOKEN_Expect(const char *expected)
+// --------------------------------------------------------------
+// error messages
+
+
+/*
+ *  Error
+ */
+
+void ASMX_Error(const char *message)
 {
-    Str255 s;
-    TOKEN_GetWord(s);
-    if (strcmp(s, expected) != 0)
+    errFlag = true;
+    errCount++;
+
+    char *name = cl_SrcName;
+    int line = linenum;
+    if (nInclude >= 0)
     {
-        snprintf(s, sizeof s, "\"%s\" expected", expected);
-        ASMX_Error(s);
-        return 1;
+        name = incname[nInclude];
+        line = incline[nInclude];
+    }
+
+    if (pass == 2)
+    {
+        listThisLine = true;
+        if (cl_List)    fprintf(listing, "%s:%d: *** Error:  %s ***\n", name, line, message);
+        if (cl_Err)     fprintf(stderr,  "%s%s:%d: *** Error:  %s ***\n", errPrefix, name, line, message);
     }
-    return 0;
 }
 
 
-bool TOKEN_Comma()
+/*
+ *  ASMX_Warning
+ */
+
+void ASMX_Warning(const char *message)
 {
-    return TOKEN_Expect(",");
-}
+    warnFlag = true;
 
+    char *name = cl_SrcName;
+    int line = linenum;
+    if (nInclude >= 0)
+    {
+        name = incname[nInclude];
+        line = incline[nInclude];
+    }
 
-bool TOKEN_RParen()
-{
-    return TOKEN_Expect(")");
+    if (pass == 2 && cl_Warn)
+    {
+        listThisLine = true;
+        if (cl_List)    fprintf(listing, "%s:%d: *** Warning:  %s ***\n", name, line, message);
+        if (cl_Warn)    fprintf(stderr,  "%s%s:%d: *** Warning:  %s ***\n", errPrefix, name, line, message);
+    }
 }
 
 
-void TOKEN_EatIt()
-{
-    Str255  word;
-    while (TOKEN_GetWord(word));      // eat junk at end of line
-}
+// --------------------------------------------------------------
+// string utilities
 
 
 /*
- *  ASMX_IllegalOperand
+ *  Debleft deblanks the string s from the left side
  */
 
-void ASMX_IllegalOperand()
+void Debleft(char *s)
 {
-    ASMX_Error("Illegal operand");
-    TOKEN_EatIt();
+    char *p = s;
+
+    while (*p == 9 || *p == ' ')
+    {
+        p++;
+    }
+
+    if (p != s)
+    {
+        while ((*s++ = *p++)) /* copy until end of string */;
+    }
 }
 
 
 /*
- *  ASMX_MissingOperand
+ *  Debright deblanks the string s from the right side
  */
 
-void ASMX_MissingOperand()
+void Debright(char *s)
 {
-    ASMX_Error("Missing operand");
-    TOKEN_EatIt();
+    char *p = s + strlen(s);
+
+    while (p > s && *--p == ' ')
+    {
+        *p = 0;
+    }
 }
 
 
 /*
- *  TOKEN_BadMode
+ *  Deblank removes blanks from both ends of the string s
  */
-void TOKEN_BadMode()
+
+void Deblank(char *s)
 {
-    ASMX_Error("Illegal addressing mode");
-    TOKEN_EatIt();
+    Debleft(s);
+    Debright(s);
 }
 
 
-// find a register name
-// regList is a space-separated list of register names
-// FindReg returns:
-//       -2 (aka reg_EOL) if empty string
-//      -1 (aka reg_None) if no register found
-//      0 if regName is the first register in regList
-//      1 if regName is the second register in regList
-//      etc.
-int REG_Find(const char *regName, const char *regList)
+/*
+ *  Uprcase converts string s to upper case
+ */
+
+void Uprcase(char *s)
 {
-    if (!regName[0]) return reg_EOL;
+    char *p = s;
 
-    int i = 0;
-    while (*regList)
-    {
-        const char *p = regName;
-        // compare words
-        while (*p && *p == *regList)
-        {
-            regList++;
-            p++;
-        }
+    while ((*p = toupper(*p)))
+        p++;
+}
 
-        // if not match, skip rest of word
-        if (*p || (*regList != 0 && *regList != ' '))
-        {
-            // skip to next whitespace
-            while (*regList && *regList != ' ')
-            {
-                regList++;
-            }
-            // skip to next word
-            while (*regList == ' ')
-            {
-                regList++;
-            }
-            i++;
-        }
-        else
-        {
-            return i;
-        }
-    }
 
-    return reg_None;
+int ishex(char c)
+{
+    c = toupper(c);
+    return isdigit(c) || ('A' <= c && c <= 'F');
 }
 
 
-// get a word and find a register name
-// regList is a space-separated list of register names
-// REG_Get returns:
-//      -2 (aka reg_EOL) and reports a "missing operand" error if end of line
-//      -1 (aka reg_None) if no register found
-//      0 if regName is the first register in regList
-//      1 if regName is the second register in regList
-//      etc.
-int REG_Get(const char *regList)
+int isoctal(char c)
 {
-    Str255  word;
+    return ('0' <= c && c <= '7');
+}
 
-    char *oldLine = linePtr;
-    if (!TOKEN_GetWord(word))
-    {
-        ASMX_MissingOperand();
-        return reg_EOL;
-    }
 
-    int reg = REG_Find(word, regList);
-    if (reg < 0)
-    {
-        linePtr = oldLine;
-    }
-    return reg;
+int isalphaul(char c)
+{
+    c = toupper(c);
+    return ('A' <= c && c <= 'Z') || c == '_';
 }
 
 
-// check if a register from FindReg/REG_Get is valid
-int REG_Check(int reg) // may want to add a maxreg parameter
+int isalphanum(char c)
 {
-    if (reg == reg_EOL)
-    {
-        ASMX_MissingOperand();      // abort if not valid register
-        return 1;
-    }
-//  if ((reg < 0) || (reg > maxReg))
-    if (reg < 0)
-    {
-        ASMX_IllegalOperand();      // abort if not valid register
-        return 1;
-    }
-    return 0;
+    c = toupper(c);
+    return isdigit(c) || ('A' <= c && c <= 'Z') || c == '_';
 }
 
 
-static int GetBackslashChar(void)
+static unsigned int EvalBin(const char *binStr)
 {
-    Str255      s;
+    unsigned int binVal = 0;
+    bool evalErr = false;
 
-    if (!*linePtr)
+    char c;
+    while ((c = *binStr++))
     {
-        return -1;
+        if (c < '0' || c > '1')
+        {
+            evalErr = true;
+        }
+        else
+        {
+            binVal = binVal * 2 + c - '0';
+        }
     }
 
-    unsigned char ch = *linePtr++;
-    if (ch == '\\' && *linePtr != 0)   // backslash
+    if (evalErr)
     {
-        ch = *linePtr++;
-        switch (ch)
-        {
-            case 'r':
-                ch = '\r';
-                break;
-            case 'n':
-                ch = '\n';
-                break;
-            case 't':
-                ch = '\t';
-                break;
-            case 'x':
-                if (ishex(linePtr[0]) && ishex(linePtr[1]))
-                {
-                    s[0] = linePtr[0];
-                    s[1] = linePtr[1];
-                    s[2] = 0;
-                    linePtr = linePtr + 2;
-                    ch = EvalHex(s);
-                }
-                break;
-            default:
-                break;
-        }
+        binVal = 0;
+        ASMX_Error("Invalid binary number");
     }
 
-    return ch;
+    return binVal;
 }
 
 
-// --------------------------------------------------------------
-// macro handling
-
-
-static MacroRec *FindMacro(const char *name)
+static unsigned int EvalOct(const char *octStr)
 {
-    MacroRec *p = macroTab;
-    bool found = false;
+    unsigned int octVal = 0;
+    bool evalErr = false;
 
-    while (p && !found)
+    char c;
+    while ((c = *octStr++))
     {
-        found = (strcmp(p -> name, name) == 0);
-        if (!found)
+        if (c < '0' || c > '7')
         {
-            p = p -> next;
+            evalErr = true;
+        }
+        else
+        {
+            octVal = octVal * 8 + c - '0';
         }
     }
 
-    return p;
-}
-
-
-static MacroRec *NewMacro(const char *name)
-{
-    MacroRec *p = (MacroRec *) malloc(sizeof *p + strlen(name));
-
-    if (p)
-    {
-        strcpy(p -> name, name);
-        p -> def     = false;
-        p -> toomany = false;
-        p -> text    = NULL;
-        p -> next    = macroTab;
-        p -> parms   = NULL;
-        p -> nparms  = 0;
-    }
-
-    return p;
-}
-
-
-static MacroRec *AddMacro(const char *name)
-{
-    MacroRec *p = NewMacro(name);
-
-    if (p)
+    if (evalErr)
     {
-        macroTab = p;
+        octVal = 0;
+        ASMX_Error("Invalid octal number");
     }
 
-    return p;
+    return octVal;
 }
 
 
-static void AddMacroParm(MacroRec *macro, const char *name)
+static unsigned int EvalSplitOct(const char *octStr)
 {
-    MacroParm *parm = (MacroParm *) malloc(sizeof *parm + strlen(name));
+    unsigned int octVal = 0;
+    int len = strlen(octStr);
+    bool evalErr = len > 6;
 
-    parm -> next = NULL;
-    strcpy(parm -> name, name);
-    macro -> nparms++;
+    // xxxyyyA format was used by Heath to represent
+    // octal as separate octal bytes xxx and yyy
+    // as would be seen on an H8 front panel
+    // 377377A represents 0xFFFF
 
-    MacroParm *p = macro -> parms;
-    if (p)
+    char c;
+    int digit = 0;
+    while ((c = *octStr++))
     {
-        while (p -> next)
+        if (c < '0' || c > '7' || (c > '3' && (len - digit) % 3 == 0))
         {
-            p = p -> next;
+            evalErr = true;
         }
-        p -> next = parm;
+        else
+        {
+            if (digit == len - 3)
+            {
+                octVal = octVal * 4 + c - '0';
+            }
+            else
+            {
+                octVal = octVal * 8 + c - '0';
+            }
+        }
+        digit++;
     }
-    else
+
+    if (evalErr)
     {
-        macro -> parms = parm;
+        octVal = 0;
+        ASMX_Error("Invalid split-octal number");
     }
+
+    return octVal;
 }
 
 
-static void AddMacroLine(MacroRec *macro, const char *line)
+static unsigned int EvalDec(const char *decStr)
 {
-    MacroLine *m = (MacroLine *) malloc(sizeof *m + strlen(line));
+    unsigned int decVal = 0;
+    bool evalErr = false;
 
-    if (m)
+    char c;
+    while ((c = *decStr++))
     {
-        m -> next = NULL;
-        strcpy(m -> text, line);
-
-        MacroLine *p = macro -> text;
-        if (p)
+        if (!isdigit(c))
         {
-            while (p -> next)
-            {
-                p = p -> next;
-            }
-            p -> next = m;
+            evalErr = true;
         }
         else
         {
-            macro -> text = m;
+            decVal = decVal * 10 + c - '0';
         }
     }
+
+    if (evalErr)
+    {
+        decVal = 0;
+        ASMX_Error("Invalid decimal number");
+    }
+
+    return decVal;
 }
 
 
-static void GetMacParms(MacroRec *macro)
+static int Hex2Dec(int c)
 {
-    macCurrentID[macLevel] = macUniqueID++;
-
-    for (int i = 0; i < MAXMACPARMS; i++)
+    c = toupper(c);
+    if (c > '9')
     {
-        macParms[i + macLevel * MAXMACPARMS] = NULL;
+        return c - 'A' + 10;
     }
+    return c - '0';
+}
 
-    // skip initial whitespace
-    char c = *linePtr;
-    while (c == 12 || c == '\t' || c == ' ')
-    {
-        c = *++linePtr;
-    }
 
-    // copy rest of line for safekeeping
-    strcpy(macParmsLine[macLevel], linePtr);
+static unsigned int EvalHex(const char *hexStr)
+{
+    unsigned int hexVal = 0;
+    bool evalErr = false;
 
-    int n = 0;
-    char *p = macParmsLine[macLevel];
-    while (*p && *p != ';' && n < MAXMACPARMS)
+    char c;
+    while ((c = *hexStr++))
     {
-        // skip whitespace before current parameter
-        c = *p;
-        while (c == 12 || c == '\t' || c == ' ')
+        if (!ishex(c))
         {
-            c = *++p;
+            evalErr = true;
         }
-
-        // record start of parameter
-        macParms[n + macLevel * MAXMACPARMS] = p;
-        n++;
-
-        char quote = 0;
-        bool done = false;
-        // skip to end of parameter
-        while (!done)
+        else
         {
-            c = *p++;
-            switch (c)
-            {
-                case 0:
-                    --p;
-                    done = true;
-                    break;
-
-                case ';':
-                    if (quote == 0)
-                    {
-                        *--p = 0;
-                        done = true;
-                    }
-                    break;
-
-                case ',':
-                    if (quote == 0)
-                    {
-                        *(p-1) = 0;
-                        done = true;
-                    }
-                    break;
-
-                case 0x27:  // quote
-                case '"':
-                    if (quote == 0)
-                    {
-                        quote = c;
-                    }
-                    else if (quote == c)
-                    {
-                        quote = 0;
-                    }
-            }
+            hexVal = hexVal * 16 + Hex2Dec(c);
         }
     }
 
-    numMacParms[macLevel] = n;
-
-    // terminate last parameter and point remaining parameters to null strings
-    *p = 0;
-    for (int i = n; i < MAXMACPARMS; i++)
+    if (evalErr)
     {
-        macParms[i + macLevel * MAXMACPARMS] = p;
+        hexVal = 0;
+        ASMX_Error("Invalid hexadecimal number");
     }
 
-    // remove whitespace from end of parameter
-    for (int i = 0; i < MAXMACPARMS; i++)
+    return hexVal;
+}
+
+
+static unsigned int EvalNum(char *word)
+{
+    // handle C-style 0xnnnn hexadecimal constants
+    if(word[0] == '0')
     {
-        if (macParms[i + macLevel * MAXMACPARMS])
+        if (toupper(word[1]) == 'X')
         {
-            p = macParms[i + macLevel * MAXMACPARMS] + strlen(macParms[i + macLevel * MAXMACPARMS]) - 1;
-            while (p >= macParms[i + macLevel * MAXMACPARMS] && (*p == ' ' || *p == 9))
-            {
-                *p-- = 0;
-            }
+            return EvalHex(word+2);
         }
+        // return EvalOct(word);    // 0nnn octal constants are in less demand, though
     }
 
-    if (n > macro -> nparms || n > MAXMACPARMS)
+    unsigned int val = strlen(word) - 1;
+    switch (word[val])
     {
-        ASMX_Error("Too many macro parameters");
-    }
-}
-
+        case 'A': // nnnnnnA format used by Heath
+            word[val] = 0;
+            val = EvalSplitOct(word);
+            break;
 
-static void DoMacParms()
-{
-    Str255      word, word2;
+        case 'B':
+            word[val] = 0;
+            val = EvalBin(word);
+            break;
 
-    // start at beginning of line
-    linePtr = line;
+        case 'O':
+        case 'Q':
+            word[val] = 0;
+            val = EvalOct(word);
+            break;
 
-    // skip initial whitespace
-    char c = *linePtr;
-    while (c == 12 || c == '\t' || c == ' ')
-    {
-        c = *++linePtr;
-    }
+        case 'D':
+            word[val] = 0;
+            val = EvalDec(word);
+            break;
 
-    // while not end of line
+        case 'H':
+            word[val] = 0;
+            val = EvalHex(word);
+            break;
+
+        default:
+            val = EvalDec(word);
+            break;
+    }
+
+    return val;
+}
+
+
+// --------------------------------------------------------------
+// listing hex output routines
+
+char *LIST_Str(char *l, const char *s)
+{
+    // copy string to line
+    while (*s) *l++ = *s++;
+
+    return l;
+}
+
+
+char *LIST_Byte(char *p, uint8_t b)
+{
+    char s[16]; // with extra space for just in case
+
+    sprintf(s, "%.2X", b);
+    return LIST_Str(p, s);
+}
+
+
+char *LIST_Word(char *p, uint16_t w)
+{
+    char s[16]; // with extra space for just in case
+
+    sprintf(s, "%.4X", w);
+    return LIST_Str(p, s);
+}
+
+
+char *ListLong24(char *p, uint32_t l)
+{
+    char s[16]; // with extra space for just in case
+
+    sprintf(s, "%.6X", l & 0xFFFFFF);
+    return LIST_Str(p, s);
+}
+
+
+char *LIST_Long(char *p, uint32_t l)
+{
+    char s[16]; // with extra space for just in case
+
+    sprintf(s, "%.8X", l);
+    return LIST_Str(p, s);
+}
+
+
+char *LIST_Addr(char *p, uint32_t addr)
+{
+    switch (addrWid)
+    {
+        default:
+        case ADDR_16:
+            p = LIST_Word(p, addr);
+            break;
+
+        case ADDR_24:
+            p = ListLong24(p, addr);
+            break;
+
+        case ADDR_32: // you need listWid == LIST_24 with this too
+            p = LIST_Long(p, addr);
+            break;
+    };
+
+    return p;
+}
+
+char *LIST_Loc(uint32_t addr)
+{
+    char *p = LIST_Addr(listLine, addr);
+
+    *p++ = ' ';
+    if (listWid == LIST_24 && addrWid == ADDR_16)
+    {
+        *p++ = ' ';
+    }
+
+    return p;
+}
+
+// --------------------------------------------------------------
+// ZSCII conversion routines
+
+uint8_t zStr[MAX_BYTSTR];   // output data buffer
+int     zLen;               // length of output data
+int     zOfs, zPos;         // current output offset (in bytes) and bit position
+int     zShift;             // current shift lock status (0, 1, 2)
+const char zSpecial[] = "0123456789.,!?_#'\"/\\<-:()"; // special chars table
+
+
+static void InitZSCII(void)
+{
+    zOfs = 0;
+    zPos = 0;
+    zLen = 0;
+    zShift = 0;
+}
+
+
+static void PutZSCII(char nib)
+{
+    nib = nib & 0x1F;
+
+    // is it time to start a new word?
+    if (zPos == 3)
+    {
+        // check for overflow
+        if (zOfs >= MAX_BYTSTR)
+        {
+            if (!errFlag) ASMX_Error("ZSCII string length overflow");
+            return;
+        }
+        zOfs = zOfs + 2;
+        zPos = 0;
+    }
+
+    switch (zPos)
+    {
+        case 0:
+            zStr[zOfs] = nib << 2;
+            break;
+
+        case 1:
+            zStr[zOfs] |= nib >> 3;
+            zStr[zOfs+1] = nib << 5;
+            break;
+
+        case 2:
+            zStr[zOfs+1] |= nib;
+            break;
+
+        default:    // this shouldn't happen!
+            break;
+    }
+
+    zPos++;
+}
+
+
+static void PutZSCIIShift(char shift, char nshift)
+{
+    int lock = 0;                   // only do a temp shift if next shift is different
+
+    if (shift == nshift) lock = 2;  // generate shift lock if next shift is same
+
+    switch ((shift - zShift + 3) % 3)
+    {
+        case 0: // no shift
+            break;
+
+        case 1: // shift forward
+            PutZSCII(0x02 + lock);
+            break;
+
+        case 2: // shift backwards
+            PutZSCII(0x03 + lock);
+            break;
+    }
+
+    if (lock) zShift = shift;       // update shift lock state
+}
+
+
+static void EndZSCII(void)
+{
+    // pad final word with shift nibbles
+    while (zPos != 3)
+    {
+        PutZSCII(0x05);
+    }
+
+    // set high bit in final word as end-of-text marker
+    zStr[zOfs] |= 0x80;
+
+    zOfs = zOfs + 2;
+}
+
+
+static int GetZSCIIShift(char ch)
+{
+    if (ch == ' ')  return -2;
+    if (ch == '\n') return -1;
+    if ('a' <= ch && ch <= 'z') return 0;
+    if ('A' <= ch && ch <= 'Z') return 1;
+    return 2;
+}
+
+
+static void ConvertZSCII(void)
+{
+    //  input data is in bytStr[]
+    //  input data length is instrLen
+
+    char    *p;                         // pointer for looking up special chars
+
+    InitZSCII();
+
+    int inpos = 0;                      // input position
+    while (inpos < instrLen)
+    {
+        // get current char and shift
+        char ch = bytStr[inpos];        // current input byte
+        int shift = GetZSCIIShift(ch);  // current shift state
+        int nshift = shift;             // next shift state
+
+        // determine next char's shift (skipping blanks and newlines, stopping at end of data)
+        int i = inpos + 1;
+        while (i < instrLen && (nshift = GetZSCIIShift(bytStr[i])) < 0) i++;
+        if (i >= instrLen) nshift = zShift;    // if end of data, use current shift as "next" shift
+
+        switch (shift)
+        {
+            case 0: // alpha lower case
+            case 1: // alpha upper case
+                PutZSCIIShift(shift, nshift);
+                PutZSCII(ch - 'A' + 6);
+                break;
+
+            case 2: // non-alpha
+                if ((p = strchr(zSpecial, ch)))
+                {
+                    // numeric and special chars
+                    PutZSCIIShift(shift, nshift);
+                    PutZSCII(p - zSpecial + 7);
+                }
+                else
+                {
+                    // extended char
+                    PutZSCIIShift(shift, nshift);
+                    PutZSCII(0x06);
+                    PutZSCII(ch >> 5);
+                    PutZSCII(ch);
+                }
+                break;
+
+            default: // blank and newline
+                PutZSCII(shift + 2);
+                break;
+        }
+
+        inpos++;
+    }
+
+    EndZSCII();
+
+    memcpy(bytStr, zStr, zOfs);
+    instrLen = zOfs;
+}
+
+
+// --------------------------------------------------------------
+// token handling
+
+static int TOKEN_ScanWord(char *word)
+{
+    word[0] = 0;
+
+    // skip initial whitespace
+    char c = *linePtr;
+    while (c == 12 || c == '\t' || c == ' ')
+    {
+        c = *++linePtr;
+    }
+
+    // skip comments
+    if (c == ';')
+    {
+        while (c)
+        {
+            c = *++linePtr;
+        }
+    }
+
+    // test for end of line
+    if (c)
+    {
+        // test for alphanumeric token
+#if 1
+        if (isalphanum(c) ||
+                (
+                    (((opts & OPT_DOLLARSYM) && c == '$') || ((opts & OPT_ATSYM) && c == '@'))
+                    && ((isalphanum(linePtr[1]) ||
+                         linePtr[1]=='$' ||
+                         ((opts & OPT_ATSYM) && linePtr[1]=='@'))
+                       )
+                ))
+
+#else
+
+#ifdef DOLLAR_SYM
+        if (isalphanum(c) || (c == '$' && (isalphanum(linePtr[1]) || linePtr[1]=='$')))
+#else
+        if (isalphanum(c))
+#endif
+
+#endif
+        {
+            while (isalphanum(c) || c == '$' || ((opts & OPT_ATSYM) && c == '@'))
+            {
+                *word++ = toupper(c);
+                c = *++linePtr;
+            }
+            *word = 0;
+            return -1;
+        }
+        else
+        {
+            word[0] = c;
+            word[1] = 0;
+            linePtr++;
+            return c;
+        }
+    }
+
+    return 0;
+}
+
+
+// returns 0 for end-of-line, -1 for alpha-numeric, else char value for non-alphanumeric
+// converts the word to uppercase, too
+int TOKEN_GetWord(char *word)
+{
+    STAT_Enter(STAT_LEX);
+    int token = TOKEN_ScanWord(word);
+    STAT_Leave();
+
+    return token;
+}
+
+
+static int TOKEN_ScanOpcode(char *word)
+{
+    word[0] = 0;
+
+    // skip initial whitespace
+    char c = *linePtr;
+    while (c == 12 || c == '\t' || c == ' ')
+    {
+        c = *++linePtr;
+    }
+
+    // skip comments
+    if (c == ';')
+    {
+        while (c)
+        {
+            c = *++linePtr;
+        }
+    }
+
+    // test for ":="
+    if (c == ':' && linePtr[1] == '=')
+    {
+        word[0] = ':';
+        word[1] = '=';
+        word[2] = 0;
+        linePtr = linePtr + 2;
+        return -1;
+    }
+    else if (c)
+    {
+        // test for end of line
+        // test for alphanumeric token
+        if (isalphanum(c) || c=='.')
+        {
+            while (isalphanum(c) || c=='.')
+            {
+                *word++ = toupper(c);
+                c = *++linePtr;
+            }
+            *word = 0;
+            return -1;
+        }
+        else
+        {
+            word[0] = c;
+            word[1] = 0;
+            linePtr++;
+            return c;
+        }
+    }
+
+    return 0;
+}
+
+
+// same as GetWord, except it allows '.' chars in alphanumerics and ":=" as a token
+int GetOpcode(char *word)
+{
+    STAT_Enter(STAT_LEX);
+    int token = TOKEN_ScanOpcode(word);
+    STAT_Leave();
+
+    return token;
+}
+
+
+void GetFName(char *word)
+{
+    // skip leading whitespace
+    while (*linePtr == ' ' || *linePtr == '\t')
+    {
+        linePtr++;
+    }
+    char *oldLine = word;
+
+    // check for quote at start of file name
+    char quote = 0;
+    if (*linePtr == '"' || *linePtr == '\'')
+    {
+        quote = *linePtr++;
+    }
+
+    // continue reading until quote or whitespace or EOL
+    while (*linePtr != 0 && *linePtr != quote &&
+            (quote || (*linePtr != ' ' && *linePtr != '\t')))
+    {
+        char ch = *linePtr++;
+        if (ch == '\\' && *linePtr != 0)
+        {
+            ch = *linePtr++;
+        }
+        *oldLine++ = ch;
+    }
+    *oldLine++ = 0;
+
+    // if looking for quote, error on end quote
+    if (quote)
+    {
+        if (*linePtr == quote)
+        {
+            linePtr++;
+        }
+        else
+        {
+            ASMX_Error("Missing close quote");
+        }
+    }
+}
+
+
+bool TOKEN_Expect(const char *expected)
+{
+    Str255 s;
+    TOKEN_GetWord(s);
+    if (strcmp(s, expected) != 0)
+    {
+        snprintf(s, sizeof s, "\"%s\" expected", expected);
+        ASMX_Error(s);
+        return 1;
+    }
+    return 0;
+}
+
+
+bool TOKEN_Comma()
+{
+    return TOKEN_Expect(",");
+}
+
+
+bool TOKEN_RParen()
+{
+    return TOKEN_Expect(")");
+}
+
+
+void TOKEN_EatIt()
+{
+    Str255  word;
+    while (TOKEN_GetWord(word));      // eat junk at end of line
+}
+
+
+/*
+ *  ASMX_IllegalOperand
+ */
+
+void ASMX_IllegalOperand()
+{
+    ASMX_Error("Illegal operand");
+    TOKEN_EatIt();
+}
+
+
+/*
+ *  ASMX_MissingOperand
+ */
+
+void ASMX_MissingOperand()
+{
+    ASMX_Error("Missing operand");
+    TOKEN_EatIt();
+}
+
+
+/*
+ *  TOKEN_BadMode
+ */
+void TOKEN_BadMode()
+{
+    ASMX_Error("Illegal addressing mode");
+    TOKEN_EatIt();
+}
+
+
+// find a register name
+// regList is a space-separated list of register names
+// FindReg returns:
+//       -2 (aka reg_EOL) if empty string
+//      -1 (aka reg_None) if no register found
+//      0 if regName is the first register in regList
+//      1 if regName is the second register in regList
+//      etc.
+int REG_Find(const char *regName, const char *regList)
+{
+    if (!regName[0]) return reg_EOL;
+
+    int i = 0;
+    while (*regList)
+    {
+        const char *p = regName;
+        // compare words
+        while (*p && *p == *regList)
+        {
+            regList++;
+            p++;
+        }
+
+        // if not match, skip rest of word
+        if (*p || (*regList != 0 && *regList != ' '))
+        {
+            // skip to next whitespace
+            while (*regList && *regList != ' ')
+            {
+                regList++;
+            }
+            // skip to next word
+            while (*regList == ' ')
+            {
+                regList++;
+            }
+            i++;
+        }
+        else
+        {
+            return i;
+        }
+    }
+
+    return reg_None;
+}
+
+
+// get a word and find a register name
+// regList is a space-separated list of register names
+// REG_Get returns:
+//      -2 (aka reg_EOL) and reports a "missing operand" error if end of line
+//      -1 (aka reg_None) if no register found
+//      0 if regName is the first register in regList
+//      1 if regName is the second register in regList
+//      etc.
+int REG_Get(const char *regList)
+{
+    Str255  word;
+
+    char *oldLine = linePtr;
+    if (!TOKEN_GetWord(word))
+    {
+        ASMX_MissingOperand();
+        return reg_EOL;
+    }
+
+    int reg = REG_Find(word, regList);
+    if (reg < 0)
+    {
+        linePtr = oldLine;
+    }
+    return reg;
+}
+
+
+// check if a register from FindReg/REG_Get is valid
+int REG_Check(int reg) // may want to add a maxreg parameter
+{
+    if (reg == reg_EOL)
+    {
+        ASMX_MissingOperand();      // abort if not valid register
+        return 1;
+    }
+//  if ((reg < 0) || (reg > maxReg))
+    if (reg < 0)
+    {
+        ASMX_IllegalOperand();      // abort if not valid register
+        return 1;
+    }
+    return 0;
+}
+
+
+static int GetBackslashChar(void)
+{
+    Str255      s;
+
+    if (!*linePtr)
+    {
+        return -1;
+    }
+
+    unsigned char ch = *linePtr++;
+    if (ch == '\\' && *linePtr != 0)   // backslash
+    {
+        ch = *linePtr++;
+        switch (ch)
+        {
+            case 'r':
+                ch = '\r';
+                break;
+            case 'n':
+                ch = '\n';
+                break;
+            case 't':
+                ch = '\t';
+                break;
+            case 'x':
+                if (ishex(linePtr[0]) && ishex(linePtr[1]))
+                {
+                    s[0] = linePtr[0];
+                    s[1] = linePtr[1];
+                    s[2] = 0;
+                    linePtr = linePtr + 2;
+                    ch = EvalHex(s);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return ch;
+}
+
+
+// --------------------------------------------------------------
+// macro handling
+
+
+static MacroRec *FindMacro(const char *name)
+{
+    MacroRec *p = macroTab;
+    bool found = false;
+
+    while (p && !found)
+    {
+        found = (strcmp(p -> name, name) == 0);
+        if (!found)
+        {
+            p = p -> next;
+        }
+    }
+
+    return p;
+}
+
+
+static MacroRec *NewMacro(const char *name)
+{
+    MacroRec *p = (MacroRec *) malloc(sizeof *p + strlen(name));
+
+    if (p)
+    {
+        strcpy(p -> name, name);
+        p -> def     = false;
+        p -> toomany = false;
+        p -> text    = NULL;
+        p -> next    = macroTab;
+        p -> parms   = NULL;
+        p -> nparms  = 0;
+    }
+
+    return p;
+}
+
+
+static MacroRec *AddMacro(const char *name)
+{
+    MacroRec *p = NewMacro(name);
+
+    if (p)
+    {
+        macroTab = p;
+    }
+
+    return p;
+}
+
+
+static void AddMacroParm(MacroRec *macro, const char *name)
+{
+    MacroParm *parm = (MacroParm *) malloc(sizeof *parm + strlen(name));
+
+    parm -> next = NULL;
+    strcpy(parm -> name, name);
+    macro -> nparms++;
+
+    MacroParm *p = macro -> parms;
+    if (p)
+    {
+        while (p -> next)
+        {
+            p = p -> next;
+        }
+        p -> next = parm;
+    }
+    else
+    {
+        macro -> parms = parm;
+    }
+}
+
+
+static void AddMacroLine(MacroRec *macro, const char *line)
+{
+    MacroLine *m = (MacroLine *) malloc(sizeof *m + strlen(line));
+
+    if (m)
+    {
+        m -> next = NULL;
+        strcpy(m -> text, line);
+
+        MacroLine *p = macro -> text;
+        if (p)
+        {
+            while (p -> next)
+            {
+                p = p -> next;
+            }
+            p -> next = m;
+        }
+        else
+        {
+            macro -> text = m;
+        }
+    }
+}
+
+
+static void GetMacParms(MacroRec *macro)
+{
+    macCurrentID[macLevel] = macUniqueID++;
+
+    for (int i = 0; i < MAXMACPARMS; i++)
+    {
+        macParms[i + macLevel * MAXMACPARMS] = NULL;
+    }
+
+    // skip initial whitespace
+    char c = *linePtr;
+    while (c == 12 || c == '\t' || c == ' ')
+    {
+        c = *++linePtr;
+    }
+
+    // copy rest of line for safekeeping
+    strcpy(macParmsLine[macLevel], linePtr);
+
+    int n = 0;
+    char *p = macParmsLine[macLevel];
+    while (*p && *p != ';' && n < MAXMACPARMS)
+    {
+        // skip whitespace before current parameter
+        c = *p;
+        while (c == 12 || c == '\t' || c == ' ')
+        {
+            c = *++p;
+        }
+
+        // record start of parameter
+        macParms[n + macLevel * MAXMACPARMS] = p;
+        n++;
+
+        char quote = 0;
+        bool done = false;
+        // skip to end of parameter
+        while (!done)
+        {
+            c = *p++;
+            switch (c)
+            {
+                case 0:
+                    --p;
+                    done = true;
+                    break;
+
+                case ';':
+                    if (quote == 0)
+                    {
+                        *--p = 0;
+                        done = true;
+                    }
+                    break;
+
+                case ',':
+                    if (quote == 0)
+                    {
+                        *(p-1) = 0;
+                        done = true;
+                    }
+                    break;
+
+                case 0x27:  // quote
+                case '"':
+                    if (quote == 0)
+                    {
+                        quote = c;
+                    }
+                    else if (quote == c)
+                    {
+                        quote = 0;
+                    }
+            }
+        }
+    }
+
+    numMacParms[macLevel] = n;
+
+    // terminate last parameter and point remaining parameters to null strings
+    *p = 0;
+    for (int i = n; i < MAXMACPARMS; i++)
+    {
+        macParms[i + macLevel * MAXMACPARMS] = p;
+    }
+
+    // remove whitespace from end of parameter
+    for (int i = 0; i < MAXMACPARMS; i++)
+    {
+        if (macParms[i + macLevel * MAXMACPARMS])
+        {
+            p = macParms[i + macLevel * MAXMACPARMS] + strlen(macParms[i + macLevel * MAXMACPARMS]) - 1;
+            while (p >= macParms[i + macLevel * MAXMACPARMS] && (*p == ' ' || *p == 9))
+            {
+                *p-- = 0;
+            }
+        }
+    }
+
+    if (n > macro -> nparms || n > MAXMACPARMS)
+    {
+        ASMX_Error("Too many macro parameters");
+    }
+}
+
+
+static void DoMacParms()
+{
+    Str255      word, word2;
+
+    // start at beginning of line
+    linePtr = line;
+
+    // skip initial whitespace
+    char c = *linePtr;
+    while (c == 12 || c == '\t' || c == ' ')
+    {
+        c = *++linePtr;
+    }
+
+    // while not end of line
     char *p = linePtr; // pointer to start of word
     int token = TOKEN_GetWord(word);
     while (token)
     {
-        // if alphanumeric, search for macro parameter of the same name
-        if (token == -1)
+        // if alphanumeric, search for macro parameter of the same name
+        if (token == -1)
+        {
+            int i = 0;
+            MacroParm *parm = macPtr[macLevel] -> parms;
+            while (parm && strcmp(parm -> name, word))
+            {
+                parm = parm -> next;
+                i++;
+            }
+
+            // if macro parameter found, replace parameter name with parameter value
+            if (parm)
+            {
+                // copy from linePtr to temp string
+                strcpy(word, linePtr);
+                // copy from corresponding parameter to p
+                strcpy(p, macParms[i + macLevel * MAXMACPARMS]);
+                // point p to end of appended text
+                p = p + strlen(macParms[i + macLevel * MAXMACPARMS]);
+                // copy from temp to p
+                strcpy(p, word);
+                // update linePtr
+                linePtr = p;
+            }
+        }
+        else if (token == '#' && *linePtr == '#')
+        {
+            // handle '##' concatenation operator
+            p = linePtr + 1;    // skip second '#'
+            linePtr--;          // skip first '#'
+            // skip whitespace to the left
+            while (linePtr > line && linePtr[-1] == ' ')
+            {
+                linePtr--;
+            }
+            // skip whitespace to the right
+            while (*p == ' ') p++;
+            // copy right side of chopped zone
+            strcpy(word, p);
+            // paste it at new linePtr
+            strcpy(linePtr, word);
+            // and linePtr now even points to where it should
+        }
+        else if (token == '\\' && *linePtr == '0')
+        {
+            // handle '\0' number of parameters operator
+            p = linePtr + 1;    // skip '0'
+            linePtr--;          // skip '\'
+            // make string of number of parameters
+            sprintf(word2, "%d", numMacParms[macLevel]);
+            // copy right side of chopped zone
+            strcpy(word, p);
+            // paste number
+            strcpy(linePtr, word2);
+            linePtr = linePtr + strlen(word2);
+            // paste right side at new linePtr
+            strcpy(linePtr, word);
+        }
+        else if (token == '\\' && '1' <= *linePtr && *linePtr <= '9')
+        {
+            // handle '\n' parameter operator
+            int i = *linePtr - '1';
+            p = linePtr + 1;    // skip 'n'
+            linePtr--;          // skip '\'
+            // copy right side of chopped zone
+            strcpy(word, p);
+            // paste parameter
+            strcpy(linePtr, macParms[i + macLevel * MAXMACPARMS]);
+            linePtr = linePtr + strlen(macParms[i + macLevel * MAXMACPARMS]);
+            // paste right side at new linePtr
+            strcpy(linePtr, word);
+        }
+        else if (token == '\\' && *linePtr == '?')
+        {
+            // handle '\?' unique ID operator
+            p = linePtr + 1;    // skip '?'
+            linePtr--;          // skip '\'
+            // make string of number of parameters
+            sprintf(word2, "%.5d", macCurrentID[macLevel]);
+            // copy right side of chopped zone
+            strcpy(word, p);
+            // paste number
+            strcpy(linePtr, word2);
+            linePtr = linePtr + strlen(word2);
+            // paste right side at new linePtr
+            strcpy(linePtr, word);
+        }
+        /* just use "\##" instead to avoid any confusion with \\ inside of DB pseudo-op
+                // handle '\\' escape
+                else if (token == '\\' && *linePtr == '\\') {
+                    p = linePtr + 1;    // skip second '\'
+                    // copy right side of chopped zone
+                    strcpy(word, p);
+                    // paste right side at new linePtr
+                    strcpy(linePtr, word);
+                }
+        */
+
+        // skip initial whitespace
+        c = *linePtr;
+        while (c == 12 || c == '\t' || c == ' ')
+        {
+            c = *++linePtr;
+        }
+
+        p = linePtr;
+        token = TOKEN_GetWord(word);
+    }
+}
+
+
+static void DumpMacro(MacroRec *p)
+{
+    if (cl_List)
+    {
+        fprintf(listing, "--- Macro '%s' ---", p -> name);
+        fprintf(listing, " def = %d, nparms = %d\n", p -> def, p -> nparms);
+
+        // dump parms here
+        fprintf(listing, "Parms:");
+        for (MacroParm *parm = p->parms; parm; parm = parm->next)
+        {
+            fprintf(listing, " '%s'", parm->name);
+        }
+        fprintf(listing, "\n");
+
+        // dump text here
+        for (MacroLine *line = p->text; line; line = line->next)
+        {
+            fprintf(listing, " '%s'\n", line->text);
+        }
+    }
+}
+
+
+/*static*/ void DumpMacroTab(void)
+{
+    MacroRec *p = macroTab;
+
+    while (p)
+    {
+        DumpMacro(p);
+        p = p -> next;
+    }
+}
+
+
+// --------------------------------------------------------------
+// opcodes handling
+
+
+/*
+ *  FindOpcodeTab - finds an entry in an opcode table
+ */
+
+// special compare for opcodes to allow "*" wildcard
+static int opcode_strcmp(const char *s1, const char *s2)
+{
+    while (*s1 == *s2++)
+    {
+        if (*s1++ == 0) return 0;
+    }
+    if (*s1 == '*') return 0; // this is the magic
+    return (*s1 - *(s2 - 1));
+}
+
+
+static const OpcdRec *FindOpcodeTab(const OpcdRec *p, const char *name, int *typ, int *parm)
+{
+    bool found = false;
+
+//  while (p -> typ != o_Illegal && !found)
+    while (*(p -> name) && !found)
+    {
+        found = (opcode_strcmp(p -> name, name) == 0);
+        if (!found)
+        {
+            p++;
+        }
+        else
+        {
+            *typ  = p -> typ;
+            *parm = p -> parm;
+        }
+    }
+
+    if (!found) p = NULL; // because this is an array, not a linked list
+    return p;
+}
+
+
+/*
+ *  FindOpcode - finds an opcode in either the generic or CPU-specific
+ *               opcode tables, or as a macro name
+ */
+
+static const OpcdRec *GetFindOpcode(char *opcode, int *typ, int *parm, MacroRec **macro)
+{
+    STAT_Enter(STAT_OPCODE);
+
+    *typ   = OP_Illegal;
+    *parm  = 0;
+    *macro = NULL;
+
+    const OpcdRec *p = NULL;
+    if (GetOpcode(opcode))
+    {
+        if (opcdTab) p = FindOpcodeTab(opcdTab,  opcode, typ, parm);
+        if (!p)
+        {
+            if (opcode[0] == '.') opcode++; // allow pseudo-ops to be invoked as ".OP"
+            p = FindOpcodeTab((OpcdRec *) &opcdTab2, opcode, typ, parm);
+        }
+        if (p)
+        {
+            // if wildcard was matched, back up linePtr
+            // NOTE: if wildcard matched an empty string, linePtr will be
+            //       unchanged and point to whitespace
+            int len = strlen(p->name);
+            if (len && (p->name[len-1] == '*'))
+            {
+                linePtr = linePtr - (strlen(opcode) - len + 1);
+            }
+        }
+        else
+        {
+            if ((*macro = FindMacro(opcode)))
+            {
+                *typ = OP_MacName;
+                p = opcdTab2; // return dummy non-null valid opcode pointer
+            }
+        }
+    }
+
+    STAT_Leave();
+    return p;
+}
+
+
+// --------------------------------------------------------------
+// symbol table
+
+
+struct XrefSite
+{
+    const TextFile  *file;      // file of definition or reference
+    int             line;       // line number in file
+    uint32_t        addr;       // locPtr in pass 2
+    bool            def;        // true for a definition, false for a reference
+};
+typedef struct XrefSite XrefSite;
+
+struct SymRec
+{
+    struct SymRec   *next;      // pointer to next symtab entry
+    struct SymRec   *locals;    // temporary labels scoped to this symbol
+    uint32_t        value;      // symbol value
+    bool            defined;    // true if defined
+    bool            multiDef;   // true if multiply defined
+    bool            isSet;      // true if defined with SET pseudo
+    bool            equ;        // true if defined with EQU pseudo
+    bool            known;      // true if value is known
+    int             iter;       // pass 1 iteration where it was last defined, for --relax
+    const TextFile  *defFile;   // file where symbol was defined, NULL for -d
+    int             defLine;    // line number where symbol was defined
+    SegRec          *defSeg;    // segment where symbol was defined
+    XrefSite        *sites;     // cross reference definition and reference sites
+    int             nSites;     // number of sites used
+    int             maxSites;   // number of sites allocated
+    char            name[1];    // symbol name, storage = 1 + length
+} *symTab = NULL;           // pointer to first entry in symbol table
+typedef struct SymRec SymRec;
+
+SymRec          *scopeTab = NULL;   // temp label scopes with no global symbol (SUBROUTINE names, etc.)
+SymRec          *curScope = NULL;   // most recently used temp label scope
+
+
+/*
+ *  SYM_IsTemp - returns true if symName is a '.' (or '@') temporary label
+ */
+
+static bool SYM_IsTemp(const char *symName)
+{
+#ifdef TEMP_LBLAT
+    return strchr(symName, '.') || strchr(symName, '@');
+#else
+    return strchr(symName, '.') != NULL;
+#endif
+}
+
+
+/*
+ *  SYM_FindIn - finds a symbol in a single symbol list
+ */
+
+static SymRec *SYM_FindIn(SymRec *p, const char *symName)
+{
+    bool found = false;
+
+    statPass[pass].symFind++;
+    while (p && !found)
+    {
+        statPass[pass].symProbe++;
+        found = (strcmp(p -> name, symName) == 0);
+        if (!found)
+        {
+            p = p -> next;
+        }
+    }
+
+    return p;
+}
+
+
+/*
+ *  SYM_AddTo - adds a new symbol to the front of a symbol list
+ */
+
+static SymRec *SYM_AddTo(SymRec **tab, const char *symName)
+{
+    SymRec *p = (SymRec *) malloc(sizeof *p + strlen(symName));
+    statSymbols++;
+
+    strcpy(p -> name, symName);
+    p -> value    = 0;
+    p -> next     = *tab;
+    p -> locals   = NULL;
+    p -> defined  = false;
+    p -> multiDef = false;
+    p -> isSet    = false;
+    p -> equ      = false;
+    p -> known    = false;
+    p -> iter     = 0;
+    p -> defFile  = NULL;
+    p -> defLine  = 0;
+    p -> defSeg   = NULL;
+    p -> sites    = NULL;
+    p -> nSites   = 0;
+    p -> maxSites = 0;
+
+    *tab = p;
+
+    return p;
+}
+
+
+/*
+ *  SYM_FindScope - finds the scope that owns a temporary label
+ *
+ *  Temporary labels are kept in a small list attached to their owning
+ *  global label (or SUBROUTINE name) instead of the global symbol table,
+ *  so they only get searched while their scope is in use.  The owner is
+ *  whatever comes before the '.' (or '@') in the full label name.
+ */
+
+static SymRec *SYM_FindScope(const char *symName)
+{
+    Str255 scope;
+
+#ifdef TEMP_LBLAT
+    int len = strcspn(symName, ".@");
+#else
+    int len = strcspn(symName, ".");
+#endif
+    memcpy(scope, symName, len);
+    scope[len] = 0;
+
+    // usually still in the same scope as the last temp label
+    if (curScope && strcmp(curScope -> name, scope) == 0)
+    {
+        return curScope;
+    }
+
+    SymRec *p = SYM_FindIn(scopeTab, scope);
+    if (p == NULL)
+    {
+        p = SYM_FindIn(symTab, scope);
+    }
+    if (p == NULL)
+    {
+        p = SYM_AddTo(&scopeTab, scope);
+    }
+
+    curScope = p;
+    return p;
+}
+
+
+/*
+ *  SYM_Find
+ */
+
+static SymRec *SYM_Find(const char *symName)
+{
+    if (SYM_IsTemp(symName))
+    {
+        return SYM_FindIn(SYM_FindScope(symName) -> locals, symName);
+    }
+
+    return SYM_FindIn(symTab, symName);
+}
+
+
+/*
+ *  SYM_Add
+ */
+
+static SymRec *SYM_Add(const char *symName)
+{
+    if (SYM_IsTemp(symName))
+    {
+        return SYM_AddTo(&SYM_FindScope(symName) -> locals, symName);
+    }
+
+    return SYM_AddTo(&symTab, symName);
+}
+
+
+/*
+ *  SYM_MergeLocals - moves all temporary labels into the global symbol table
+ *                    (only done at the end for the symbol table dump)
+ */
+
+static void SYM_MergeLocals(SymRec *p)
+{
+    while (p)
+    {
+        SymRec *q = p -> locals;
+        while (q)
+        {
+            SymRec *next = q -> next;
+            q -> next = symTab;
+            symTab = q;
+            q = next;
+        }
+        p -> locals = NULL;
+        p = p -> next;
+    }
+}
+
+
+// returns the file being assembled, and its current line number
+static const TextFile *SYM_CurFile(int *line)
+{
+    if (nInclude >= 0)
+    {
+        *line = incline[nInclude];
+        return incfile[nInclude];
+    }
+
+    *line = linenum;
+    return srcFile;
+}
+
+
+/*
+ *  SYM_AddSite - adds a cross reference site for a symbol in pass 2
+ *
+ *  The sites are kept in a growing array for each symbol.  More than one
+ *  use on the same line only counts once.
+ */
+
+static void SYM_AddSite(SymRec *p, bool def)
+{
+    if (pass != 2 || !cl_XrefName[0])
+    {
+        return;
+    }
+
+    int line;
+    const TextFile *file = SYM_CurFile(&line);
+
+    if (p -> nSites)
+    {
+        XrefSite *last = &p -> sites[p -> nSites - 1];
+        if (last -> file == file && last -> line == line && last -> def == def)
+        {
+            return;
+        }
+    }
+
+    if (p -> nSites == p -> maxSites)
+    {
+        p -> maxSites = p -> maxSites ? p -> maxSites * 2 : 4;
+        p -> sites = (XrefSite *) realloc(p -> sites, p -> maxSites * sizeof *p -> sites);
+    }
+
+    XrefSite *site = &p -> sites[p -> nSites++];
+    site -> file = file;
+    site -> line = line;
+    site -> addr = locPtr;
+    site -> def  = def;
+}
+
+
+/*
+ *  SYM_Ref
+ */
+
+static int SYM_Ref(const char *symName, bool *known)
+{
+    SymRec *p;
+    Str255 s;
+
+    if ((p = SYM_Find(symName)))
+    {
+        SYM_AddSite(p, false);
+
+        if (!p -> defined)
+        {
+            snprintf(s, sizeof s, "Symbol '%s' undefined", symName);
+            ASMX_Error(s);
+        }
+        switch (pass)
+        {
+            case 1:
+                if (!p -> defined) *known = false;
+                break;
+            case 2:
+                if (!p -> known)
+                {
+                    // with --relax, use the value from the last pass 1 iteration like it did
+                    if (relaxFlag && p -> defined)
+                    {
+                        evalRelaxed = true;
+                    }
+                    else
+                    {
+                        *known = false;
+                    }
+                }
+                break;
+        }
+#if 0 // FIXME: possible fix that may be needed for 16-bit address
+        if (addrWid == ADDR_16)
+        {
+            return (short) p -> value;    // sign-extend from 16 bits
+        }
+#endif
+        return p -> value;
+    }
+
+    // check for 'FFH' style constants here
+    int i = strlen(symName) - 1;
+    if (toupper(symName[i]) != 'H')
+    {
+        i = -1;
+    }
+    else
+    {
+        while (i > 0 && ishex(symName[i-1]))
+        {
+            i--;
+        }
+    }
+
+    if (i == 0)
+    {
+        strncpy(s, symName, 255);
+        s[strlen(s)-1] = 0;
+        return EvalHex(s);
+    }
+    else
+    {
+        p = SYM_Add(symName);
+        *known = false;
+//      snprintf(s, sizeof s, "Symbol '%s' undefined", symName);
+//      Error(s);
+    }
+
+    return 0;
+}
+
+
+/*
+ *  SYM_Def
+ */
+
+void SYM_Def(const char *symName, uint32_t val, bool setSym, bool equSym)
+{
+    Str255 s;
+
+    if (symName[0])   // ignore null string symName
+    {
+        SymRec *p = SYM_Find(symName);
+        if (p == NULL)
+        {
+            p = SYM_Add(symName);
+        }
+
+        if (!setSym && !equSym)
+        {
+            codeLabels++;
+        }
+
+        // with --relax, a symbol from the previous pass 1 iteration is defined again
+        // (iter is 0 for -d symbols, which are only defined once)
+        if (pass == 1 && p -> defined && p -> iter != 0 && p -> iter != relaxIter)
+        {
+            if (!p -> isSet && p -> value != val)
+            {
+                relaxChanged = true;
+            }
+            p -> defined = false;
+        }
+
+        if (!p -> defined || (p -> isSet && setSym))
+        {
+            // symbol has not been defined yet
+            // or a SET symbol is being re-defined
+            p -> value = val;
+            p -> defined = true;
+            p -> isSet = setSym;
+            p -> equ = equSym;
+            p -> iter = relaxIter;
+
+            // remember where it was defined for the symbol map
+            if (pass != 0)
+            {
+                p -> defFile = SYM_CurFile(&p -> defLine);
+                p -> defSeg = curSeg;
+            }
+        }
+        else if (p -> value != val)
+        {
+            // trying to re-define a non-SET symbol
+            p -> multiDef = true;
+            if (pass == 2 && !p -> known)
+            {
+                sprintf(s, "Phase error");
+            }
+            else
+            {
+                snprintf(s, sizeof s, "Symbol '%s' multiply defined", symName);
+            }
+            ASMX_Error(s);
+        }
+
+        if (pass == 0 || pass == 2) p -> known = true;
+
+        SYM_AddSite(p, true);
+    }
+}
+
+
+static void SYM_Dump(SymRec *p, char *s, int *w)
+{
+    int n = 0;
+    int max = MAXSYMLEN;
+
+    char *s2 = p->name;
+    int len = strlen(s2);
+
+    *w = 1;
+    while (max-1 < len)
+    {
+        *w = *w + 1;
+        max = max + MAXSYMLEN + 8; // 8 = number of extra chars between symbol names
+    }
+
+    while (*s2 && n < max)
+    {
+        *s++ = *s2++;
+        n++;
+    }
+
+    while (n < max)
+    {
+        *s++ = ' ';
+        n++;
+    }
+
+    switch (addrMax)
+    {
+        default:
+        case ADDR_16:
+            sprintf(s, "%.4X ", p->value & 0xFFFF);
+            break;
+
+        case ADDR_24:
+#if 0
+            sprintf(s, "%.6X ", p->value & 0xFFFFFF);
+            break;
+#endif
+        case ADDR_32:
+            sprintf(s, "%.8X ", p->value);
+            break;
+    }
+
+    s = s + strlen(s);
+
+    n = 0;
+    if (!p -> defined)
+    {
+        *s++ = 'U';    // Undefined
+        n++;
+    }
+    if ( p -> multiDef)
+    {
+        *s++ = 'M';    // Multiply defined
+        n++;
+    }
+    if ( p -> isSet)
+    {
+        *s++ = 'S';    // Set
+        n++;
+    }
+    if ( p -> equ)
+    {
+        *s++ = 'E';    // Equ
+        n++;
+    }
+    while (n < 3)
+    {
+        *s++ = ' ';
+        n++;
+    }
+    *s = 0;
+}
+
+
+static void SYM_DumpTab(void)
+{
+    Str255  s;
+
+    int i = 0;
+    SymRec *p = symTab;
+    while (p)
+    {
+        if (tempSymFlag || !SYM_IsTemp(p->name))
         {
-            int i = 0;
-            MacroParm *parm = macPtr[macLevel] -> parms;
-            while (parm && strcmp(parm -> name, word))
+            int w;
+            SYM_Dump(p, s, &w);
+            p = p -> next;
+
+            // force a newline if new symbol won't fit on current line
+            if (i + w > symTabCols)
             {
-                parm = parm -> next;
-                i++;
+                if (cl_List)
+                {
+                    fprintf(listing, "\n");
+                }
+                i = 0;
             }
-
-            // if macro parameter found, replace parameter name with parameter value
-            if (parm)
+            if (p == NULL || i + w >= symTabCols)
             {
-                // copy from linePtr to temp string
-                strcpy(word, linePtr);
-                // copy from corresponding parameter to p
-                strcpy(p, macParms[i + macLevel * MAXMACPARMS]);
-                // point p to end of appended text
-                p = p + strlen(macParms[i + macLevel * MAXMACPARMS]);
-                // copy from temp to p
-                strcpy(p, word);
-                // update linePtr
-                linePtr = p;
+                // if last symbol or if symbol fills line, deblank and print it
+                Debright(s);
+                if (cl_List)
+                {
+                    fprintf(listing, "%s\n", s);
+                }
+                i = 0;
             }
-        }
-        else if (token == '#' && *linePtr == '#')
-        {
-            // handle '##' concatenation operator
-            p = linePtr + 1;    // skip second '#'
-            linePtr--;          // skip first '#'
-            // skip whitespace to the left
-            while (linePtr > line && linePtr[-1] == ' ')
+            else
             {
-                linePtr--;
+                // otherwise just print it and count its width
+                if (cl_List)
+                {
+                    fprintf(listing, "%s", s);
+                }
+                i = i + w;
             }
-            // skip whitespace to the right
-            while (*p == ' ') p++;
-            // copy right side of chopped zone
-            strcpy(word, p);
-            // paste it at new linePtr
-            strcpy(linePtr, word);
-            // and linePtr now even points to where it should
-        }
-        else if (token == '\\' && *linePtr == '0')
-        {
-            // handle '\0' number of parameters operator
-            p = linePtr + 1;    // skip '0'
-            linePtr--;          // skip '\'
-            // make string of number of parameters
-            sprintf(word2, "%d", numMacParms[macLevel]);
-            // copy right side of chopped zone
-            strcpy(word, p);
-            // paste number
-            strcpy(linePtr, word2);
-            linePtr = linePtr + strlen(word2);
-            // paste right side at new linePtr
-            strcpy(linePtr, word);
-        }
-        else if (token == '\\' && '1' <= *linePtr && *linePtr <= '9')
-        {
-            // handle '\n' parameter operator
-            int i = *linePtr - '1';
-            p = linePtr + 1;    // skip 'n'
-            linePtr--;          // skip '\'
-            // copy right side of chopped zone
-            strcpy(word, p);
-            // paste parameter
-            strcpy(linePtr, macParms[i + macLevel * MAXMACPARMS]);
-            linePtr = linePtr + strlen(macParms[i + macLevel * MAXMACPARMS]);
-            // paste right side at new linePtr
-            strcpy(linePtr, word);
-        }
-        else if (token == '\\' && *linePtr == '?')
-        {
-            // handle '\?' unique ID operator
-            p = linePtr + 1;    // skip '?'
-            linePtr--;          // skip '\'
-            // make string of number of parameters
-            sprintf(word2, "%.5d", macCurrentID[macLevel]);
-            // copy right side of chopped zone
-            strcpy(word, p);
-            // paste number
-            strcpy(linePtr, word2);
-            linePtr = linePtr + strlen(word2);
-            // paste right side at new linePtr
-            strcpy(linePtr, word);
         }
-        /* just use "\##" instead to avoid any confusion with \\ inside of DB pseudo-op
-                // handle '\\' escape
-                else if (token == '\\' && *linePtr == '\\') {
-                    p = linePtr + 1;    // skip second '\'
-                    // copy right side of chopped zone
-                    strcpy(word, p);
-                    // paste right side at new linePtr
-                    strcpy(linePtr, word);
-                }
-        */
-
-        // skip initial whitespace
-        c = *linePtr;
-        while (c == 12 || c == '\t' || c == ' ')
+        else
         {
-            c = *++linePtr;
+            p = p -> next;
         }
-
-        p = linePtr;
-        token = TOKEN_GetWord(word);
     }
 }
 
 
-static void DumpMacro(MacroRec *p)
+static void SYM_SortTab()
 {
-    if (cl_List)
+    SymRec *i, *j;      // pointers to current elements
+    SymRec *ip, *jp;    // pointers to previous elements
+    SymRec *t;          // temp for swapping
+
+    // yes, it's a linked-list bubble sort
+
+    if (symTab != NULL)
     {
-        fprintf(listing, "--- Macro '%s' ---", p -> name);
-        fprintf(listing, " def = %d, nparms = %d\n", p -> def, p -> nparms);
+        ip = NULL;
+        i = symTab;
+        jp = i;
+        j = i -> next;
 
-        // dump parms here
-        fprintf(listing, "Parms:");
-        for (MacroParm *parm = p->parms; parm; parm = parm->next)
+        while (j != NULL)
         {
-            fprintf(listing, " '%s'", parm->name);
-        }
-        fprintf(listing, "\n");
+            while (j != NULL)
+            {
+                if (strcmp(i->name, j->name) > 0)
+                {
+                    // (i->name > j->name)
+                    if (ip != NULL)
+                    {
+                        ip -> next = j;
+                    }
+                    else
+                    {
+                        symTab     = j;
+                    }
+                    if (i == jp)
+                    {
+                        i -> next = j -> next;
+                        j -> next = i;
+                    }
+                    else
+                    {
+                        jp -> next = i;
 
-        // dump text here
-        for (MacroLine *line = p->text; line; line = line->next)
-        {
-            fprintf(listing, " '%s'\n", line->text);
+                        t         = i -> next;
+                        i -> next = j -> next;
+                        j -> next = t;
+                    }
+                    t = i;
+                    i = j;
+                    j = t;
+                }
+                jp = j;
+                j = j -> next;
+            }
+            ip = i;
+            i = i -> next;
+            jp = i;
+            j = i -> next;
         }
     }
 }
 
 
-/*static*/ void DumpMacroTab(void)
+/*
+ *  SYM_WriteMap - writes the symbol table to a binary symbol map file
+ *
+ *  This is for debuggers and emulators, which can mmap the file and
+ *  binary search it instead of parsing the listing.  All numbers are
+ *  little-endian, and all tables are 4-byte aligned:
+ *
+ *      header          64 bytes, see below
+ *      symbols         nSyms records of 24 bytes, sorted by name
+ *      address index   nSyms uint32 symbol numbers, sorted by value
+ *      file table      nFiles uint32 string offsets
+ *      segment table   nSegs uint32 string offsets
+ *      strings         zero-terminated names
+ *
+ *  Each symbol record is:
+ *
+ *      uint32  value
+ *      uint32  name string offset
+ *      uint32  name length
+ *      uint32  file number where it was defined, or 0xFFFFFFFF for -d
+ *      uint32  line number where it was defined
+ *      uint16  segment number, or 0xFFFF for -d
+ *      uint16  flags, SMAP_MULTIDEF etc.
+ *
+ *  Only defined symbols are written.
+ */
+
+enum
+{
+    SMAP_VERSION    = 1,
+    SMAP_HDR_SIZE   = 64,
+    SMAP_REC_SIZE   = 24,
+    SMAP_NONE       = 0xFFFFFFFF,   // no file or segment
+
+    // symbol record flags
+    SMAP_MULTIDEF   = 0x01,         // multiply defined
+    SMAP_SET        = 0x02,         // defined with SET
+    SMAP_EQU        = 0x04,         // defined with EQU
+    SMAP_TEMP       = 0x08,         // temporary label
+};
+
+
+static void SYM_Put32(uint8_t *p, uint32_t val)
 {
-    MacroRec *p = macroTab;
-
-    while (p)
-    {
-        DumpMacro(p);
-        p = p -> next;
-    }
+    p[0] = val;
+    p[1] = val >> 8;
+    p[2] = val >> 16;
+    p[3] = val >> 24;
 }
 
 
-// --------------------------------------------------------------
-// opcodes handling
+static int SYM_CmpName(const void *a, const void *b)
+{
+    const SymRec *p = *(SymRec * const *) a;
+    const SymRec *q = *(SymRec * const *) b;
 
+    return strcmp(p -> name, q -> name);
+}
 
-/*
- *  FindOpcodeTab - finds an entry in an opcode table
- */
 
-// special compare for opcodes to allow "*" wildcard
-static int opcode_strcmp(const char *s1, const char *s2)
+struct SymAddr
 {
-    while (*s1 == *s2++)
-    {
-        if (*s1++ == 0) return 0;
-    }
-    if (*s1 == '*') return 0; // this is the magic
-    return (*s1 - *(s2 - 1));
-}
+    uint32_t    value;          // symbol value
+    uint32_t    index;          // symbol number in name order
+};
+typedef struct SymAddr SymAddr;
 
 
-static const OpcdRec *FindOpcodeTab(const OpcdRec *p, const char *name, int *typ, int *parm)
+static int SYM_CmpAddr(const void *a, const void *b)
 {
-    bool found = false;
+    const SymAddr *p = (const SymAddr *) a;
+    const SymAddr *q = (const SymAddr *) b;
 
-//  while (p -> typ != o_Illegal && !found)
-    while (*(p -> name) && !found)
+    if (p -> value != q -> value)
     {
-        found = (opcode_strcmp(p -> name, name) == 0);
-        if (!found)
-        {
-            p++;
-        }
-        else
-        {
-            *typ  = p -> typ;
-            *parm = p -> parm;
-        }
+        return (p -> value < q -> value) ? -1 : 1;
     }
-
-    if (!found) p = NULL; // because this is an array, not a linked list
-    return p;
+    return (p -> index < q -> index) ? -1 : (p -> index > q -> index);
 }
 
 
-/*
- *  FindOpcode - finds an opcode in either the generic or CPU-specific
- *               opcode tables, or as a macro name
- */
-
-static const OpcdRec *GetFindOpcode(char *opcode, int *typ, int *parm, MacroRec **macro)
+// collect the defined (or cross referenced) symbols of a list and their temp labels
+static void SYM_MapList(SymRec *p, SymRec **syms, int *n, bool locals, bool xref)
 {
-    *typ   = OP_Illegal;
-    *parm  = 0;
-    *macro = NULL;
-
-    const OpcdRec *p = NULL;
-    if (GetOpcode(opcode))
+    while (p)
     {
-        if (opcdTab) p = FindOpcodeTab(opcdTab,  opcode, typ, parm);
-        if (!p)
-        {
-            if (opcode[0] == '.') opcode++; // allow pseudo-ops to be invoked as ".OP"
-            p = FindOpcodeTab((OpcdRec *) &opcdTab2, opcode, typ, parm);
-        }
-        if (p)
+        if (xref ? p -> nSites != 0 : p -> defined)
         {
-            // if wildcard was matched, back up linePtr
-            // NOTE: if wildcard matched an empty string, linePtr will be
-            //       unchanged and point to whitespace
-            int len = strlen(p->name);
-            if (len && (p->name[len-1] == '*'))
+            if (syms)
             {
-                linePtr = linePtr - (strlen(opcode) - len + 1);
+                syms[*n] = p;
             }
+            *n = *n + 1;
         }
-        else
+        if (locals)
         {
-            if ((*macro = FindMacro(opcode)))
-            {
-                *typ = OP_MacName;
-                p = opcdTab2; // return dummy non-null valid opcode pointer
-            }
+            SYM_MapList(p -> locals, syms, n, false, xref);
         }
+        p = p -> next;
     }
-
-    return p;
 }
 
 
-// --------------------------------------------------------------
-// symbol table
-
-
-struct SymRec
+static bool SYM_WriteMap(void)
 {
-    struct SymRec   *next;      // pointer to next symtab entry
-    uint32_t        value;      // symbol value
-    bool            defined;    // true if defined
-    bool            multiDef;   // true if multiply defined
-    bool            isSet;      // true if defined with SET pseudo
-    bool            equ;        // true if defined with EQU pseudo
-    bool            known;      // true if value is known
-    char            name[1];    // symbol name, storage = 1 + length
-} *symTab = NULL;           // pointer to first entry in symbol table
-typedef struct SymRec SymRec;
+    // collect the symbols and sort them by name
+    int nSyms = 0;
+    SYM_MapList(symTab, NULL, &nSyms, true, false);
+    SYM_MapList(scopeTab, NULL, &nSyms, true, false);
 
+    SymRec **syms = (SymRec **) malloc((nSyms + 1) * sizeof *syms);
+    int n = 0;
+    SYM_MapList(symTab, syms, &n, true, false);
+    SYM_MapList(scopeTab, syms, &n, true, false);
+    qsort(syms, nSyms, sizeof *syms, SYM_CmpName);
 
-/*
- *  SYM_Find
- */
-
-static SymRec *SYM_Find(const char *symName)
-{
-    SymRec *p = symTab;
-    bool found = false;
+    // sort the symbol numbers by value, then by name
+    SymAddr *addrIdx = (SymAddr *) malloc((nSyms + 1) * sizeof *addrIdx);
+    for (int i = 0; i < nSyms; i++)
+    {
+        addrIdx[i].value = syms[i] -> value;
+        addrIdx[i].index = i;
+    }
+    qsort(addrIdx, nSyms, sizeof *addrIdx, SYM_CmpAddr);
 
-    while (p && !found)
+    // number the files and segments, and size the string table
+    int nFiles = 0;
+    size_t strSize = 0;
+    for (TextFile *f = textTab; f; f = f -> next)
     {
-        found = (strcmp(p -> name, symName) == 0);
-        if (!found)
-        {
-            p = p -> next;
-        }
+        nFiles++;
+        strSize = strSize + strlen(f -> name) + 1;
+    }
+    int nSegs = 0;
+    for (SegRec *seg = segTab; seg; seg = seg -> next)
+    {
+        nSegs++;
+        strSize = strSize + strlen(seg -> name) + 1;
+    }
+    for (int i = 0; i < nSyms; i++)
+    {
+        strSize = strSize + strlen(syms[i] -> name) + 1;
     }
 
-    return p;
-}
+    uint32_t symOff  = SMAP_HDR_SIZE;
+    uint32_t addrOff = symOff  + nSyms * SMAP_REC_SIZE;
+    uint32_t fileOff = addrOff + nSyms * 4;
+    uint32_t segOff  = fileOff + nFiles * 4;
+    uint32_t strOff  = segOff  + nSegs * 4;
+    uint32_t size    = strOff  + ((strSize + 3) & ~3);
 
+    uint8_t *map = (uint8_t *) calloc(size, 1);
+    uint32_t str = 0;
 
-/*
- *  SYM_Add
- */
+    // header
+    memcpy(map, "ASMXSYM", 8);
+    SYM_Put32(map +  8, SMAP_VERSION);
+    SYM_Put32(map + 12, addrMax == ADDR_16 ? 16 : (addrMax == ADDR_24 ? 24 : 32));
+    SYM_Put32(map + 16, nSyms);
+    SYM_Put32(map + 20, symOff);
+    SYM_Put32(map + 24, addrOff);
+    SYM_Put32(map + 28, nFiles);
+    SYM_Put32(map + 32, fileOff);
+    SYM_Put32(map + 36, nSegs);
+    SYM_Put32(map + 40, segOff);
+    SYM_Put32(map + 44, strOff);
+    SYM_Put32(map + 48, strSize);
+    SYM_Put32(map + 52, SMAP_REC_SIZE);
 
-static SymRec *SYM_Add(const char *symName)
-{
-    SymRec *p = (SymRec *) malloc(sizeof *p + strlen(symName));
+    // file and segment tables
+    int i = 0;
+    for (TextFile *f = textTab; f; f = f -> next)
+    {
+        SYM_Put32(map + fileOff + i++ * 4, str);
+        strcpy((char *) map + strOff + str, f -> name);
+        str = str + strlen(f -> name) + 1;
+    }
+    i = 0;
+    for (SegRec *seg = segTab; seg; seg = seg -> next)
+    {
+        SYM_Put32(map + segOff + i++ * 4, str);
+        strcpy((char *) map + strOff + str, seg -> name);
+        str = str + strlen(seg -> name) + 1;
+    }
 
-    strcpy(p -> name, symName);
-    p -> value    = 0;
-    p -> next     = symTab;
-    p -> defined  = false;
-    p -> multiDef = false;
-    p -> isSet    = false;
-    p -> equ      = false;
-    p -> known    = false;
+    // symbol records
+    for (i = 0; i < nSyms; i++)
+    {
+        SymRec *p = syms[i];
+        uint8_t *rec = map + symOff + i * SMAP_REC_SIZE;
 
-    symTab = p;
+        uint32_t file = SMAP_NONE;
+        int j = 0;
+        for (TextFile *f = textTab; f && file == SMAP_NONE; f = f -> next, j++)
+        {
+            if (f == p -> defFile)
+            {
+                file = j;
+            }
+        }
 
-    return p;
-}
+        uint32_t segNum = SMAP_NONE;
+        j = 0;
+        for (SegRec *seg = segTab; seg && segNum == SMAP_NONE; seg = seg -> next, j++)
+        {
+            if (seg == p -> defSeg)
+            {
+                segNum = j;
+            }
+        }
 
+        int flags = 0;
+        if (p -> multiDef)          flags |= SMAP_MULTIDEF;
+        if (p -> isSet)             flags |= SMAP_SET;
+        if (p -> equ)               flags |= SMAP_EQU;
+        if (SYM_IsTemp(p -> name))  flags |= SMAP_TEMP;
 
-/*
- *  SYM_Ref
- */
+        SYM_Put32(rec +  0, p -> value);
+        SYM_Put32(rec +  4, str);
+        SYM_Put32(rec +  8, strlen(p -> name));
+        SYM_Put32(rec + 12, file);
+        SYM_Put32(rec + 16, p -> defLine);
+        SYM_Put32(rec + 20, (segNum & 0xFFFF) | (flags << 16));
 
-static int SYM_Ref(const char *symName, bool *known)
-{
-    SymRec *p;
-    Str255 s;
+        strcpy((char *) map + strOff + str, p -> name);
+        str = str + strlen(p -> name) + 1;
+    }
 
-    if ((p = SYM_Find(symName)))
+    // address index
+    for (i = 0; i < nSyms; i++)
     {
-        if (!p -> defined)
-        {
-            snprintf(s, sizeof s, "Symbol '%s' undefined", symName);
-            ASMX_Error(s);
-        }
-        switch (pass)
-        {
-            case 1:
-                if (!p -> defined) *known = false;
-                break;
-            case 2:
-                if (!p -> known) *known = false;
-                break;
-        }
-#if 0 // FIXME: possible fix that may be needed for 16-bit address
-        if (addrWid == ADDR_16)
-        {
-            return (short) p -> value;    // sign-extend from 16 bits
-        }
-#endif
-        return p -> value;
+        SYM_Put32(map + addrOff + i * 4, addrIdx[i].index);
     }
 
-    // check for 'FFH' style constants here
-    int i = strlen(symName) - 1;
-    if (toupper(symName[i]) != 'H')
+    bool ok = false;
+    FILE *f = fopen(cl_SymMapName, "wb");
+    if (f == NULL)
     {
-        i = -1;
+        fprintf(stderr, "Unable to create symbol map file '%s'!\n", cl_SymMapName);
     }
     else
     {
-        while (i > 0 && ishex(symName[i-1]))
+        ok = (fwrite(map, 1, size, f) == size);
+        ok = (fclose(f) == 0) && ok;
+        if (!ok)
         {
-            i--;
+            fprintf(stderr, "Error writing symbol map file '%s': %s\n", cl_SymMapName, strerror(errno));
         }
     }
 
-    if (i == 0)
-    {
-        strncpy(s, symName, 255);
-        s[strlen(s)-1] = 0;
-        return EvalHex(s);
-    }
-    else
-    {
-        p = SYM_Add(symName);
-        *known = false;
-//      snprintf(s, sizeof s, "Symbol '%s' undefined", symName);
-//      Error(s);
-    }
+    free(map);
+    free(addrIdx);
+    free(syms);
 
-    return 0;
+    return ok;
 }
 
 
 /*
- *  SYM_Def
+ *  SYM_WriteXref - writes the cross reference file
+ *
+ *  Each line is one definition or reference site:
+ *
+ *      name value D|R file:line address
+ *
+ *  The lines are sorted by symbol name, with the definitions of each
+ *  symbol before its references, so the file can be binary searched
+ *  by name (as with look(1)) or just grepped.
+ *
+ *  After the sites comes an index, with one line for each symbol:
+ *
+ *      ~ name offset count
+ *
+ *  giving the file offset of the symbol's first site line and its number
+ *  of sites.  The last line is "~ index offset", the file offset of the
+ *  first index line, so a tool can seek straight to the index.  The
+ *  '~' sorts after any symbol name, so look(1) still works.
  */
 
-void SYM_Def(const char *symName, uint32_t val, bool setSym, bool equSym)
+static bool SYM_WriteXref(void)
 {
-    Str255 s;
+    int nSyms = 0;
+    SYM_MapList(symTab, NULL, &nSyms, true, true);
+    SYM_MapList(scopeTab, NULL, &nSyms, true, true);
 
-    if (symName[0])   // ignore null string symName
+    SymRec **syms = (SymRec **) malloc((nSyms + 1) * sizeof *syms);
+    long *offs = (long *) malloc((nSyms + 1) * sizeof *offs);
+    if (syms == NULL || offs == NULL)
     {
-        SymRec *p = SYM_Find(symName);
-        if (p == NULL)
-        {
-            p = SYM_Add(symName);
-        }
+        fprintf(stderr, "%s: Out of memory for --xref index\n", progname);
+        exit(1);
+    }
+    int n = 0;
+    SYM_MapList(symTab, syms, &n, true, true);
+    SYM_MapList(scopeTab, syms, &n, true, true);
+    qsort(syms, nSyms, sizeof *syms, SYM_CmpName);
 
-        if (!p -> defined || (p -> isSet && setSym))
-        {
-            // symbol has not been defined yet
-            // or a SET symbol is being re-defined
-            p -> value = val;
-            p -> defined = true;
-            p -> isSet = setSym;
-            p -> equ = equSym;
-        }
-        else if (p -> value != val)
+    const char *fmt = (addrMax == ADDR_16) ? "%.4X" : "%.8X";
+
+    bool ok = false;
+    FILE *f = fopen(cl_XrefName, "w");
+    if (f == NULL)
+    {
+        fprintf(stderr, "Unable to create cross reference file '%s'!\n", cl_XrefName);
+    }
+    else
+    {
+        for (int i = 0; i < nSyms; i++)
         {
-            // trying to re-define a non-SET symbol
-            p -> multiDef = true;
-            if (pass == 2 && !p -> known)
+            SymRec *p = syms[i];
+            offs[i] = ftell(f);
+
+            // definitions first, then references
+            for (int def = 1; def >= 0; def--)
             {
-                sprintf(s, "Phase error");
+                for (int j = 0; j < p -> nSites; j++)
+                {
+                    XrefSite *site = &p -> sites[j];
+                    if (site -> def == def)
+                    {
+                        fprintf(f, "%s ", p -> name);
+                        fprintf(f, fmt, p -> value);
+                        fprintf(f, " %c %s:%d ", def ? 'D' : 'R',
+                                site -> file ? site -> file -> name : "-", site -> line);
+                        fprintf(f, fmt, site -> addr);
+                        fprintf(f, "\n");
+                    }
+                }
             }
-            else
+        }
+
+        // index of the first site line of each symbol
+        long index = ftell(f);
+        for (int i = 0; i < nSyms; i++)
+        {
+            if (syms[i] -> nSites)
             {
-                snprintf(s, sizeof s, "Symbol '%s' multiply defined", symName);
+                fprintf(f, "~ %s %ld %d\n", syms[i] -> name, offs[i], syms[i] -> nSites);
             }
-            ASMX_Error(s);
         }
+        fprintf(f, "~ index %ld\n", index);
 
-        if (pass == 0 || pass == 2) p -> known = true;
+        ok = !ferror(f);
+        ok = (fclose(f) == 0) && ok;
+        if (!ok)
+        {
+            fprintf(stderr, "Error writing cross reference file '%s': %s\n", cl_XrefName, strerror(errno));
+        }
     }
+
+    free(offs);
+    free(syms);
+
+    return ok;
 }
 
 
-static void SYM_Dump(SymRec *p, char *s, int *w)
-{
-    int n = 0;
-    int max = MAXSYMLEN;
+// --------------------------------------------------------------
+// relaxation
+//
+// Normally, an instruction that refers to a label later in the source has
+// to use its longest form, since pass 1 doesn't know where the label is.
+// With --relax, pass 1 is repeated until no label moves.  Each time, the
+// labels keep their values from the previous time, so EXPR_Eval() treats
+// them as known, and the assemblers choose short forms from those values.
+// Pass 2 then uses the same values, and gets the same instruction sizes.
+//
+// Code does not always get smaller from one iteration to the next.
+// Alignment and padding (ALIGN, EVEN, literal pools) can grow when the code
+// before them shrinks, a short form can stop fitting when its target moves
+// (like a 68000 branch to the next instruction, whose short form would have
+// an offset of 0), and some forms depend on which page something lands on
+// (8051 AJMP, 8048 SEL MB).  So a form that fit once may not fit the next
+// time, and the layout could go back and forth.  Forms that are known to
+// do that use RELAX_Site(), which keeps a site in its long form once it has
+// needed it, so those sites can only change once.  Anything else that
+// keeps changing stops after MAX_RELAX iterations, and pass 2 reports a
+// phase error for any label that still moved.
+
+enum { RELAX_MAX_FORM = 32 };       // max length of a form name
+
+struct RelaxRec
+{
+    struct RelaxRec     *next;      // next form
+    int                 count;      // number of times this form was used
+    int                 bytes;      // total bytes saved
+    int                 cycles;     // total cycles saved
+    char                name[RELAX_MAX_FORM];   // form name, like "BRA.S"
+};
+typedef struct RelaxRec RelaxRec;
 
-    char *s2 = p->name;
-    int len = strlen(s2);
+RelaxRec        *relaxTab;          // list of forms noted in pass 2
+uint8_t         *relaxLong;         // true for each site that needs its long form
+int             relaxSite;          // number of the next site in this pass
+int             relaxMax;           // number of sites allocated in relaxLong[]
+FILE            *relaxFile;         // per-site relaxation report file
 
-    *w = 1;
-    while (max-1 < len)
+
+/*
+ *  RELAX_Site - returns true if a short form can be used, for forms
+ *               that can stop fitting when code before them shrinks
+ *
+ *  Sites are numbered by the order they are assembled in, so this must
+ *  be called for every instance of the instruction, in both passes.
+ *  Once a site doesn't fit after the first pass 1 iteration, it keeps
+ *  using its long form, so that the layout can't go back and forth.
+ *  All the sites that don't fit go long in the same iteration.  That
+ *  only needs another iteration if it moves a label, which SYM_Def()
+ *  already notices.  But once a label has moved in this iteration, the
+ *  sites after it are judged from stale label values, so a site that
+ *  doesn't fit then only uses its long form this time, and is checked
+ *  again in the next iteration.
+ */
+
+bool RELAX_Site(bool fits)
+{
+    if (!relaxFlag)
     {
-        *w = *w + 1;
-        max = max + MAXSYMLEN + 8; // 8 = number of extra chars between symbol names
+        return fits;
     }
 
-    while (*s2 && n < max)
+    int site = relaxSite++;
+    if (site >= relaxMax)
     {
-        *s++ = *s2++;
-        n++;
+        int n = relaxMax ? relaxMax * 2 : 1024;
+        relaxLong = (uint8_t *) realloc(relaxLong, n);
+        memset(relaxLong + relaxMax, 0, n - relaxMax);
+        relaxMax = n;
     }
 
-    while (n < max)
+    if (pass == 1 && relaxIter > 1 && !fits && !relaxChanged)
     {
-        *s++ = ' ';
-        n++;
+        relaxLong[site] = true;
     }
 
-    switch (addrMax)
-    {
-        default:
-        case ADDR_16:
-            sprintf(s, "%.4X ", p->value & 0xFFFF);
-            break;
+    return fits && !relaxLong[site];
+}
 
-        case ADDR_24:
-#if 0
-            sprintf(s, "%.6X ", p->value & 0xFFFFFF);
-            break;
-#endif
-        case ADDR_32:
-            sprintf(s, "%.8X ", p->value);
-            break;
-    }
 
-    s = s + strlen(s);
+/*
+ *  RELAX_Note - counts an instruction form chosen in pass 2, and the bytes
+ *               and cycles it saved compared to the longest form
+ */
 
-    n = 0;
-    if (!p -> defined)
-    {
-        *s++ = 'U';    // Undefined
-        n++;
-    }
-    if ( p -> multiDef)
-    {
-        *s++ = 'M';    // Multiply defined
-        n++;
-    }
-    if ( p -> isSet)
+void RELAX_Note(const char *form, int bytes, int cycles)
+{
+    if (pass != 2)
     {
-        *s++ = 'S';    // Set
-        n++;
+        return;
     }
-    if ( p -> equ)
+
+    RelaxRec *p = relaxTab;
+    while (p && strcmp(p -> name, form) != 0)
     {
-        *s++ = 'E';    // Equ
-        n++;
+        p = p -> next;
     }
-    while (n < 3)
+    if (p == NULL)
     {
-        *s++ = ' ';
-        n++;
+        p = (RelaxRec *) malloc(sizeof *p);
+        strncpy(p -> name, form, sizeof p -> name - 1);
+        p -> name[sizeof p -> name - 1] = 0;
+        p -> count  = 0;
+        p -> bytes  = 0;
+        p -> cycles = 0;
+        p -> next   = relaxTab;
+        relaxTab = p;
     }
-    *s = 0;
-}
-
-
-static void SYM_DumpTab(void)
-{
-    Str255  s;
+    p -> count++;
+    p -> bytes  += bytes;
+    p -> cycles += cycles;
 
-    int i = 0;
-    SymRec *p = symTab;
-    while (p)
+    if (relaxFile)
     {
-#ifdef TEMP_LBLAT
-        if (tempSymFlag || !(strchr(p->name, '.') || strchr(p->name, '@')))
-#else
-        if (tempSymFlag || !strchr(p->name, '.'))
-#endif
-        {
-            int w;
-            SYM_Dump(p, s, &w);
-            p = p -> next;
-
-            // force a newline if new symbol won't fit on current line
-            if (i + w > symTabCols)
-            {
-                if (cl_List)
-                {
-                    fprintf(listing, "\n");
-                }
-                i = 0;
-            }
-            if (p == NULL || i + w >= symTabCols)
-            {
-                // if last symbol or if symbol fills line, deblank and print it
-                Debright(s);
-                if (cl_List)
-                {
-                    fprintf(listing, "%s\n", s);
-                }
-                i = 0;
-            }
-            else
-            {
-                // otherwise just print it and count its width
-                if (cl_List)
-                {
-                    fprintf(listing, "%s", s);
-                }
-                i = i + w;
-            }
-        }
-        else
+        int line;
+        const TextFile *file = SYM_CurFile(&line);
+        fprintf(relaxFile, "%s:%d: %.4X %s", file ? file -> name : "-", line, locPtr, form);
+        if (bytes || cycles)
         {
-            p = p -> next;
+            fprintf(relaxFile, " (saved %d bytes, %d cycles)", bytes, cycles);
         }
+        fprintf(relaxFile, "\n");
     }
 }
 
 
-static void SYM_SortTab()
+static int RELAX_Compare(const void *a, const void *b)
 {
-    SymRec *i, *j;      // pointers to current elements
-    SymRec *ip, *jp;    // pointers to previous elements
-    SymRec *t;          // temp for swapping
+    return strcmp((*(RelaxRec * const *) a) -> name, (*(RelaxRec * const *) b) -> name);
+}
 
-    // yes, it's a linked-list bubble sort
 
-    if (symTab != NULL)
+// write the summary of forms chosen to a listing or report file
+static void RELAX_Summary(FILE *f)
+{
+    int n = 0;
+    for (RelaxRec *p = relaxTab; p; p = p -> next)
     {
-        ip = NULL;
-        i = symTab;
-        jp = i;
-        j = i -> next;
+        n++;
+    }
 
-        while (j != NULL)
-        {
-            while (j != NULL)
-            {
-                if (strcmp(i->name, j->name) > 0)
-                {
-                    // (i->name > j->name)
-                    if (ip != NULL)
-                    {
-                        ip -> next = j;
-                    }
-                    else
-                    {
-                        symTab     = j;
-                    }
-                    if (i == jp)
-                    {
-                        i -> next = j -> next;
-                        j -> next = i;
-                    }
-                    else
-                    {
-                        jp -> next = i;
+    RelaxRec **list = (RelaxRec **) malloc((n + 1) * sizeof *list);
+    n = 0;
+    for (RelaxRec *p = relaxTab; p; p = p -> next)
+    {
+        list[n++] = p;
+    }
+    qsort(list, n, sizeof *list, RELAX_Compare);
 
-                        t         = i -> next;
-                        i -> next = j -> next;
-                        j -> next = t;
-                    }
-                    t = i;
-                    i = j;
-                    j = t;
-                }
-                jp = j;
-                j = j -> next;
-            }
-            ip = i;
-            i = i -> next;
-            jp = i;
-            j = i -> next;
-        }
+    int bytes  = 0;
+    int cycles = 0;
+    fprintf(f, "\nRelaxation: %d pass 1 iterations\n", relaxIter - 1);
+    for (int i = 0; i < n; i++)
+    {
+        fprintf(f, "    %-16s %6d used %8d bytes saved %8d cycles saved\n",
+                list[i] -> name, list[i] -> count, list[i] -> bytes, list[i] -> cycles);
+        bytes  = bytes  + list[i] -> bytes;
+        cycles = cycles + list[i] -> cycles;
     }
+    fprintf(f, "    %-16s %6s      %8d bytes saved %8d cycles saved\n", "total", "", bytes, cycles);
+
+    free(list);
 }
 
 
@@ -2846,8 +4747,13 @@ static int EXPR_Eval0(void)
 int EXPR_Eval(void)
 {
     evalKnown = true;
+    evalRelaxed = false;
 
-    return EXPR_Eval0();
+    STAT_Enter(STAT_EXPR);
+    int val = EXPR_Eval0();
+    STAT_Leave();
+
+    return val;
 }
 
 
@@ -2980,12 +4886,16 @@ enum
 #endif // CODE_COMMENTS
 };
 
-uint8_t  hex_buf[IHEX_SIZE]; // buffer for current line of object data
-uint32_t hex_len;            // current size of object data buffer
-uint32_t hex_base;           // address of start of object data buffer
-uint32_t hex_addr;           // address of next byte in object data buffer
-uint16_t hex_page;           // high word of address for intel hex file
-uint32_t bin_eof;            // current end of file when writing binary file
+// address-indexed image of all object code, used for sorted output
+enum
+{
+    IMG_PAGE_BITS = 16,                         // 64K bytes per image page
+    IMG_PAGE_SIZE = 1 << IMG_PAGE_BITS,
+    IMG_PAGES     = 1 << (32 - IMG_PAGE_BITS),  // pages in 32-bit address space
+};
+uint8_t  *img_data[IMG_PAGES];  // object code for each page, NULL if page is unused
+uint8_t  *img_used[IMG_PAGES];  // non-zero for each byte of a page that has been written
+uint32_t img_ovlEnd;            // address after the last overlap that was reported
 
 // Intel hex format:
 //
@@ -3008,38 +4918,38 @@ uint32_t bin_eof;            // current end of file when writing binary file
 // ee    = checksum byte: add all bytes aa through dd
 //                        and subtract from 256 (2's complement negate)
 
-static void OBJF_write_ihex(uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
+static void OBJF_write_ihex(ObjRec *obj, uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
 {
     if (rectype > REC_XFER) return;
 
     // if transfer record with long address, write extended address record
     if (rectype == REC_XFER && (addr & 0xFFFF0000))
     {
-        OBJF_write_ihex(addr >> 16, buf, 0, 5);
+        OBJF_write_ihex(obj, addr >> 16, buf, 0, 5);
     }
 
     // if data record with long address, write extended address record
-    if (rectype == REC_DATA && (addr >> 16) != hex_page)
+    if (rectype == REC_DATA && (addr >> 16) != obj->page)
     {
-        OBJF_write_ihex(addr >> 16, buf, 0, 4);
-        hex_page = addr >> 16;
+        OBJF_write_ihex(obj, addr >> 16, buf, 0, 4);
+        obj->page = addr >> 16;
     }
 
     // compute initial checksum from length, address, and record type
     int chksum = len + (addr >> 8) + addr + rectype;
 
     // print length, address, and record type
-    fprintf(object, ":%.2X%.4X%.2X", len, addr & 0xFFFF, rectype);
+    fprintf(obj->file, ":%.2X%.4X%.2X", len, addr & 0xFFFF, rectype);
 
     // print data while updating checksum
     for (uint32_t i = 0; i < len; i++)
     {
-        fprintf(object, "%.2X", buf[i]);
+        fprintf(obj->file, "%.2X", buf[i]);
         chksum = chksum + buf[i];
     }
 
     // print final checksum
-    fprintf(object, "%.2X\n", (-chksum) & 0xFF);
+    fprintf(obj->file, "%.2X\n", (-chksum) & 0xFF);
 }
 
 
@@ -3064,7 +4974,7 @@ static void OBJF_write_ihex(uint32_t addr, uint8_t *buf, uint32_t len, int recty
 // ee    = checksum byte: add all bytes bb through dd
 //                        and subtract from 255 (1's complement)
 
-void OBJF_write_srec(uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
+void OBJF_write_srec(ObjRec *obj, uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
 {
     if (rectype > REC_XFER) return; // should output S0 record?
 
@@ -3075,116 +4985,113 @@ void OBJF_write_srec(uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
     int typ;
     if (rectype == REC_XFER)
     {
-        typ = cl_S9type % 10;   // xfer record = S9/S8/S7
+        typ = obj->s9type % 10;   // xfer record = S9/S8/S7
     }
     else
     {
-        typ = cl_S9type / 10;   // code record = S1/S2/S3
+        typ = obj->s9type / 10;   // code record = S1/S2/S3
     }
 
     // print length and address, and update checksum for long address
-    switch (cl_S9type)
+    switch (obj->s9type)
     {
         case 37:
-            fprintf(object, "S%d%.2X%.8X", typ, len+5, addr);
+            fprintf(obj->file, "S%d%.2X%.8X", typ, len+5, addr);
             chksum = chksum + ((addr >> 24) & 0xFF) + ((addr >> 16) & 0xFF) + 2;
             break;
 
         case 28:
-            fprintf(object, "S%d%.2X%.6X", typ, len+4, addr & 0xFFFFFF);
+            fprintf(obj->file, "S%d%.2X%.6X", typ, len+4, addr & 0xFFFFFF);
             chksum = chksum + ((addr >> 16) & 0xFF) + 1;
             break;
 
         default:
             if (typ == 0) typ = 1; // handle "-s9" option
-            fprintf(object, "S%d%.2X%.4X", typ, len+3, addr & 0xFFFF);
+            fprintf(obj->file, "S%d%.2X%.4X", typ, len+3, addr & 0xFFFF);
             break;
     }
 
     // print data while updating checksum
     for (uint32_t i = 0; i < len; i++)
     {
-        fprintf(object, "%.2X", buf[i]);
+        fprintf(obj->file, "%.2X", buf[i]);
         chksum = chksum + buf[i];
     }
 
     // print final checksum
-    fprintf(object, "%.2X\n", ~chksum & 0xFF);
+    fprintf(obj->file, "%.2X\n", ~chksum & 0xFF);
 }
 
 
-void OBJF_write_bin(uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
+void OBJF_write_bin(ObjRec *obj, uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
 {
     if (rectype == REC_DATA)
     {
         // return if end of data less than base address
-        if (addr + len <= cl_Binbase) return;
+        if (addr + len <= obj->binbase) return;
 
         // return if start of data greater than end address
-        if (addr > cl_Binend) return;
+        if (addr > obj->binend) return;
 
         // if data crosses base address, adjust start of data
-        if (addr < cl_Binbase)
+        if (addr < obj->binbase)
         {
-            buf = buf + cl_Binbase - addr;
-            addr = cl_Binbase;
+            buf = buf + obj->binbase - addr;
+            addr = obj->binbase;
         }
 
         // if data crossses end address, adjust length of data
-        if (addr+len-1 > cl_Binend)
+        if (addr+len-1 > obj->binend)
         {
-            len = cl_Binend - addr + 1;
+            len = obj->binend - addr + 1;
         }
 
-        // if addr is beyond current EOF, write (addr-bin_eof) bytes of 0xFF padding
-        if (addr - cl_Binbase > bin_eof)
+        // if addr is beyond current EOF, write (addr-obj->eof) bytes of 0xFF padding
+        if (addr - obj->binbase > obj->eof)
         {
-            fseek(object, bin_eof, SEEK_SET);
-            for (uint32_t i = 0; i < addr - cl_Binbase - bin_eof; i++)
+            fseek(obj->file, obj->eof, SEEK_SET);
+            for (uint32_t i = 0; i < addr - obj->binbase - obj->eof; i++)
             {
-                fputc(0xFF, object);
+                fputc(0xFF, obj->file);
             }
         }
 
         // seek to addr and write buf
-        fseek(object, addr - cl_Binbase, SEEK_SET);
-        fwrite(buf, 1, len, object);
+        fseek(obj->file, addr - obj->binbase, SEEK_SET);
+        fwrite(buf, 1, len, obj->file);
 
-        // update EOF of object file
-        uint32_t i = ftell(object); //MIXWORX
-        if (i > bin_eof)
+        // update EOF of obj->file file
+        uint32_t i = ftell(obj->file); //MIXWORX
+        if (i > obj->eof)
         {
-            bin_eof = i;
+            obj->eof = i;
         }
 
-        //fflush(object);
+        //fflush(obj->file);
     }
 }
 
 
-uint8_t trs_buf[TRS_BUF_MAX]; // buffer for current object code data, used instead of hex_buf
-
-void OBJF_write_trsdos(uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
+void OBJF_write_trsdos(ObjRec *obj, uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
 {
     switch (rectype)
     {
         case REC_DATA:  // write data record
             // 01 len+2 ll hh data...
-            // NOTE: buf is ignored in favor of using trs_buf
-            fputc(0x01, object);
-            fputc((len+2) & 0xFF, object);
-            fputc(addr & 0xFF, object);
-            fputc((addr >> 8) & 0xFF, object);
+            fputc(0x01, obj->file);
+            fputc((len+2) & 0xFF, obj->file);
+            fputc(addr & 0xFF, obj->file);
+            fputc((addr >> 8) & 0xFF, obj->file);
 
-            fwrite(trs_buf, len, 1, object);
+            fwrite(buf, len, 1, obj->file);
             break;
 
         case REC_XFER:  // write transfer record
             // 02 02 ll hh
-            fputc(0x02, object);
-            fputc(0x02, object);
-            fputc(addr & 0xFF, object);
-            fputc((addr >> 8) & 0xFF, object);
+            fputc(0x02, obj->file);
+            fputc(0x02, obj->file);
+            fputc(addr & 0xFF, obj->file);
+            fputc((addr >> 8) & 0xFF, obj->file);
             break;
 
         case REC_HEDR:  // write header record
@@ -3192,25 +5099,25 @@ void OBJF_write_trsdos(uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
 
 #if 1
             // Note: trimming to six chars uppercase for now only to keep with standard ASMX_usage
-            fputc(0x05, object);
-            fputc(0x06, object);
+            fputc(0x05, obj->file);
+            fputc(0x06, obj->file);
 
             for (int i = 0; i < 6; i++)
             {
                 if (*buf == 0 || *buf == '.')
                 {
-                    fputc(' ', object);
+                    fputc(' ', obj->file);
                 }
                 else
                 {
-                    fputc(toupper(*buf++), object);
+                    fputc(toupper(*buf++), obj->file);
                 }
             }
 #else
-            fputc(0x05, object);
-            fputc(len, object);
+            fputc(0x05, obj->file);
+            fputc(len, obj->file);
 
-            fwrite(buf, len, 1, object);
+            fwrite(buf, len, 1, obj->file);
 #endif
             break;
 
@@ -3218,12 +5125,12 @@ void OBJF_write_trsdos(uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
         case REC_CMNT:  // write copyright record
             // 1F len data
 
-            fputc(0x1F, object);
-            fputc(len,  object);
+            fputc(0x1F, obj->file);
+            fputc(len,  obj->file);
 
             for (int i = 0; i < len; i++)
             {
-                fputc(*buf++, object);
+                fputc(*buf++, obj->file);
             }
             break;
 #endif // CODE_COMMENTS
@@ -3231,7 +5138,7 @@ void OBJF_write_trsdos(uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
 }
 
 
-void OBJF_write_trscas(uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
+void OBJF_write_trscas(ObjRec *obj, uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
 {
     uint8_t chksum;
 
@@ -3239,108 +5146,266 @@ void OBJF_write_trscas(uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
     {
         case REC_DATA:  // write data record
             // 3C len ll hh data... cs
-            // NOTE: buf is ignored in favor of using trs_buf
-            fputc(0x3C, object);
-            fputc(len & 0xFF, object);
-            fputc(addr & 0xFF, object);
-            fputc((addr >> 8) & 0xFF, object);
+            fputc(0x3C, obj->file);
+            fputc(len & 0xFF, obj->file);
+            fputc(addr & 0xFF, obj->file);
+            fputc((addr >> 8) & 0xFF, obj->file);
 
             chksum = (addr & 0xFF) + ((addr >> 8) & 0xFF);
             for (unsigned int i = 0; i < len; i++)
             {
-                chksum += trs_buf[i];
+                chksum += buf[i];
             }
 
-            fwrite(trs_buf, len, 1, object);
-            fwrite(&chksum, 1, 1, object);
+            fwrite(buf, len, 1, obj->file);
+            fwrite(&chksum, 1, 1, obj->file);
             break;
 
         case REC_XFER:  // write transfer record
             // 78 ll hh
-            fputc(0x78, object);
-            fputc(addr & 0xFF, object);
-            fputc((addr >> 8) & 0xFF, object);
+            fputc(0x78, obj->file);
+            fputc(addr & 0xFF, obj->file);
+            fputc((addr >> 8) & 0xFF, obj->file);
             break;
 
         case REC_HEDR:  // write header record
             // [00 x 255] A5 = leader and sync
             for (int i = 0; i < 255; i++)
             {
-                fputc(0x00, object);
+                fputc(0x00, obj->file);
             }
-            fputc(0xA5, object);
+            fputc(0xA5, obj->file);
 
             // 55 dd dd dd dd dd dd - dd = header data, padded with blanks
 
-            fputc(0x55, object);
+            fputc(0x55, obj->file);
 
             for (int i = 0; i < 6; i++)
             {
                 if (*buf == 0 || *buf == '.')
                 {
-                    fputc(' ', object);
+                    fputc(' ', obj->file);
                 }
                 else
                 {
-                    fputc(toupper(*buf++), object);
+                    fputc(toupper(*buf++), obj->file);
+                }
+            }
+            break;
+
+#ifdef CODE_COMMENTS
+        case REC_CMNT:
+            break;
+#endif // CODE_COMMENTS
+    }
+}
+
+
+// rectype 0 = code, rectype 1 = xfer
+static void OBJF_write_obj(ObjRec *obj, uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
+{
+    STAT_Enter(STAT_OBJECT);
+
+    switch (obj->type)
+    {
+        default:
+        case OBJ_HEX:
+            OBJF_write_ihex  (obj, addr, buf, len, rectype);
+            break;
+        case OBJ_S9:
+            OBJF_write_srec  (obj, addr, buf, len, rectype);
+            break;
+        case OBJ_BIN:
+            OBJF_write_bin   (obj, addr, buf, len, rectype);
+            break;
+        case OBJ_TRSDOS:
+            OBJF_write_trsdos(obj, addr, buf, len, rectype);
+            break;
+        case OBJ_TRSCAS:
+            OBJF_write_trscas(obj, addr, buf, len, rectype);
+            break;
+    }
+
+    STAT_Leave();
+}
+
+
+// write a record to every object file
+void OBJF_write_hex(uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
+{
+    for (ObjRec *obj = objTab; obj; obj = obj->next)
+    {
+        OBJF_write_obj(obj, addr, buf, len, rectype);
+    }
+}
+
+
+void OBJF_CodeInit(void)
+{
+    for (ObjRec *obj = objTab; obj; obj = obj->next)
+    {
+        obj->len  = 0;
+        obj->base = 0;
+        obj->addr = 0;
+        obj->page = 0;
+        obj->eof  = 0;
+
+        switch (obj->type)
+        {
+            case OBJ_TRSDOS:
+            case OBJ_TRSCAS:
+                obj->size = obj->trslen;
+                break;
+
+            default:
+                obj->size = cl_RecLen;
+                break;
+        }
+    }
+
+    img_ovlEnd = 0;
+}
+
+
+// write code into the object code image, checking for overlaps
+static void OBJF_ImageWrite(uint32_t addr, const uint8_t *buf, uint32_t len)
+{
+    Str255 s;
+
+    STAT_Enter(STAT_OBJECT);
+
+    while (len)
+    {
+        uint32_t page = addr >> IMG_PAGE_BITS;
+        uint32_t ofs  = addr & (IMG_PAGE_SIZE - 1);
+
+        if (img_data[page] == NULL)
+        {
+            img_data[page] = (uint8_t *) malloc(IMG_PAGE_SIZE);
+            img_used[page] = (uint8_t *) calloc(IMG_PAGE_SIZE, 1);
+            if (img_data[page] == NULL || img_used[page] == NULL)
+            {
+                fprintf(stderr, "%s: Out of memory for --sorted object code\n", progname);
+                exit(1);
+            }
+        }
+
+        uint32_t n = IMG_PAGE_SIZE - ofs;
+        if (n > len)
+        {
+            n = len;
+        }
+
+        // report the start of each overlapping area only once
+        uint8_t *p = (uint8_t *) memchr(img_used[page] + ofs, 1, n);
+        if (p)
+        {
+            uint32_t ovl = (page << IMG_PAGE_BITS) + (p - img_used[page]);
+            if (ovl != img_ovlEnd)
+            {
+                snprintf(s, sizeof s, "Object code overlap at address %.4X", ovl);
+                ASMX_Error(s);
+            }
+            img_ovlEnd = addr + n;
+        }
+
+        memcpy(img_data[page] + ofs, buf, n);
+        memset(img_used[page] + ofs, 1, n);
+
+        addr = addr + n;
+        buf  = buf + n;
+        len  = len - n;
+    }
+
+    STAT_Leave();
+}
+
+
+// write the object code image in ascending address order
+static void OBJF_ImageFlush(ObjRec *obj)
+{
+    for (uint32_t page = 0; page < IMG_PAGES; page++)
+    {
+        if (img_used[page])
+        {
+            uint32_t ofs = 0;
+            while (ofs < IMG_PAGE_SIZE)
+            {
+                // find the start of the next run of code
+                uint8_t *p = (uint8_t *) memchr(img_used[page] + ofs, 1, IMG_PAGE_SIZE - ofs);
+                if (p == NULL)
+                {
+                    break;
+                }
+                ofs = p - img_used[page];
+
+                // write full records up to the end of the run
+                while (ofs < IMG_PAGE_SIZE && img_used[page][ofs])
+                {
+                    uint32_t n = 0;
+                    while (n < obj->size && ofs + n < IMG_PAGE_SIZE && img_used[page][ofs + n])
+                    {
+                        n++;
+                    }
+                    OBJF_write_obj(obj, (page << IMG_PAGE_BITS) + ofs, img_data[page] + ofs, n, REC_DATA);
+                    ofs = ofs + n;
                 }
             }
-            break;
-
-#ifdef CODE_COMMENTS
-        case REC_CMNT:
-            break;
-#endif // CODE_COMMENTS
+        }
     }
 }
 
 
-// rectype 0 = code, rectype 1 = xfer
-void OBJF_write_hex(uint32_t addr, uint8_t *buf, uint32_t len, int rectype)
+void OBJF_CodeFlush(void)
 {
-    if (cl_Obj || cl_Stdout)
+    for (ObjRec *obj = objTab; obj; obj = obj->next)
     {
-        switch (cl_ObjType)
+        if (obj->len)
         {
-            default:
-            case OBJ_HEX:
-                OBJF_write_ihex  (addr, buf, len, rectype);
-                break;
-            case OBJ_S9:
-                OBJF_write_srec  (addr, buf, len, rectype);
-                break;
-            case OBJ_BIN:
-                OBJF_write_bin   (addr, buf, len, rectype);
-                break;
-            case OBJ_TRSDOS:
-                OBJF_write_trsdos(addr, buf, len, rectype);
-                break;
-            case OBJ_TRSCAS:
-                OBJF_write_trscas(addr, buf, len, rectype);
-                break;
+            OBJF_write_obj(obj, obj->base, obj->buf, obj->len, REC_DATA);
+            obj->len  = 0;
+            obj->base = obj->addr;
         }
     }
 }
 
 
-void OBJF_CodeInit(void)
+// add code to the record buffer of one object file
+static void OBJF_ObjCode(ObjRec *obj, uint32_t addr, const uint8_t *buf, uint32_t len)
 {
-    hex_len  = 0;
-    hex_base = 0;
-    hex_addr = 0;
-    hex_page = 0;
-    bin_eof  = 0;
-}
+    while (len)
+    {
+        if (addr != obj->addr)
+        {
+            if (obj->len)
+            {
+                OBJF_write_obj(obj, obj->base, obj->buf, obj->len, REC_DATA);
+                obj->len = 0;
+            }
+            obj->base = addr;
+            obj->addr = addr;
+        }
 
+        // copy as much as will fit in the current record
+        uint32_t n = obj->size - obj->len;
+        if (n > len)
+        {
+            n = len;
+        }
+        memcpy(obj->buf + obj->len, buf, n);
 
-void OBJF_CodeFlush(void)
-{
-    if (hex_len)
-    {
-        OBJF_write_hex(hex_base, hex_buf, hex_len, REC_DATA);
-        hex_len  = 0;
-        hex_base = hex_base + hex_len;
-        hex_addr = hex_base;
+        obj->len  = obj->len + n;
+        obj->addr = obj->addr + n;
+        addr      = addr + n;
+        buf       = buf + n;
+        len       = len - n;
+
+        if (obj->len == obj->size)
+        {
+            OBJF_write_obj(obj, obj->base, obj->buf, obj->len, REC_DATA);
+            obj->len  = 0;
+            obj->base = obj->addr;
+        }
     }
 }
 
@@ -3349,35 +5414,27 @@ void OBJF_CodeOut(int byte)
 {
     if (pass == 2)
     {
-        if (codPtr != hex_addr)
+        uint8_t b = byte;
+
+        profBytes++;
+        if (cl_LineTabName[0])
         {
-            OBJF_CodeFlush();
-            hex_base = codPtr;
-            hex_addr = codPtr;
+            LTAB_Code(1);
         }
-
-        switch (cl_ObjType)
+        if (cl_SizesName[0])
         {
-            case OBJ_TRSDOS:
-            case OBJ_TRSCAS:
-                trs_buf[hex_len++] = byte;
-                hex_addr++;
-
-                if (hex_len == cl_trslen)
-                {
-                    OBJF_CodeFlush();
-                }
-                break;
-
-            default:
-                hex_buf[hex_len++] = byte;
-                hex_addr++;
-
-                if (hex_len == IHEX_SIZE)
-                {
-                    OBJF_CodeFlush();
-                }
-                break;
+            SIZE_Code(1);
+        }
+        if (cl_Sorted)
+        {
+            OBJF_ImageWrite(codPtr, &b, 1);
+        }
+        else
+        {
+            for (ObjRec *obj = objTab; obj; obj = obj->next)
+            {
+                OBJF_ObjCode(obj, codPtr, &b, 1);
+            }
         }
     }
     locPtr++;
@@ -3409,9 +5466,17 @@ void OBJF_CodeEnd(void)
 
     if (pass == 2)
     {
-        if (xferFound)
+        for (ObjRec *obj = objTab; obj; obj = obj->next)
         {
-            OBJF_write_hex(xferAddr, hex_buf, 0, REC_XFER);
+            if (cl_Sorted)
+            {
+                OBJF_ImageFlush(obj);
+            }
+
+            if (xferFound)
+            {
+                OBJF_write_obj(obj, xferAddr, obj->buf, 0, REC_XFER);
+            }
         }
     }
 }
@@ -3444,6 +5509,226 @@ void OBJF_AddLocPtr(int ofs)
 }
 
 
+// write a block of bytes, used for large data that doesn't fit in bytStr[]
+void OBJF_CodeBlock(const uint8_t *buf, uint32_t len)
+{
+    if (pass == 2)
+    {
+        profBytes += len;
+        if (cl_LineTabName[0])
+        {
+            LTAB_Code(len);
+        }
+        if (cl_SizesName[0])
+        {
+            SIZE_Code(len);
+        }
+        if (cl_Sorted)
+        {
+            OBJF_ImageWrite(codPtr, buf, len);
+        }
+        else
+        {
+            for (ObjRec *obj = objTab; obj; obj = obj->next)
+            {
+                OBJF_ObjCode(obj, codPtr, buf, len);
+            }
+        }
+    }
+    OBJF_AddLocPtr(len);
+}
+
+
+// write count copies of a 1, 2, or 4 byte pattern
+void OBJF_CodeFill(const uint8_t *pat, int patLen, uint32_t count)
+{
+    uint8_t buf[4096];  // must be a multiple of every pattern size
+
+    if (count > UINT32_MAX / patLen)
+    {
+        ASMX_Error("Operand out of range");
+        return;
+    }
+
+    if (pass == 2)
+    {
+        if (patLen == 1)
+        {
+            memset(buf, pat[0], sizeof buf);
+        }
+        else
+        {
+            for (unsigned int i = 0; i < sizeof buf; i += patLen)
+            {
+                memcpy(buf + i, pat, patLen);
+            }
+        }
+
+        uint32_t len = count * patLen;
+        while (len)
+        {
+            uint32_t n = len;
+            if (n > sizeof buf)
+            {
+                n = sizeof buf;
+            }
+            OBJF_CodeBlock(buf, n);
+            len = len - n;
+        }
+    }
+    else
+    {
+        OBJF_AddLocPtr(count * patLen);
+    }
+}
+
+
+// --------------------------------------------------------------
+// literal pools
+//
+// LDR Rd,=value puts the value in a pool of longwords that is written
+// out at the next LTORG, SEG, or END, or wherever the CPU assembler
+// calls LPOOL_Flush(), such as after an unconditional branch, or after a
+// branch around the pool when LPOOL_Waiting() says the first instruction
+// that used it is about to go out of range.  Pools are numbered in the order
+// they are written, and each one's address from pass 1 is used in pass 2
+// for instructions that come before it.  Known values are only stored
+// once per pool.  Values from forward references always get their own
+// slot, so that a pool has the same size in both passes.
+
+enum { LPOOL_MAX = (MAX_BYTSTR - 16) / 4 }; // max literals in one pool
+
+uint32_t        lpoolVal[LPOOL_MAX];    // values waiting for the next pool
+bool            lpoolKnown[LPOOL_MAX];  // true if the value was known
+int             lpoolLen;               // number of values in the next pool
+int             lpoolNum;               // number of the next pool in this pass
+uint32_t        lpoolFirst;             // address of the first instruction that used the next pool
+uint32_t        *lpoolAddr;             // address of each pool from pass 1
+int             lpoolMax;               // number of addresses allocated in lpoolAddr[]
+
+
+/*
+ *  LPOOL_Add - adds a value to the next literal pool and returns the
+ *              address that it will have
+ */
+
+uint32_t LPOOL_Add(uint32_t val, bool known)
+{
+    int i = 0;
+    while (i < lpoolLen && !(known && lpoolKnown[i] && lpoolVal[i] == val))
+    {
+        i++;
+    }
+
+    if (i == lpoolLen)
+    {
+        if (lpoolLen >= LPOOL_MAX)
+        {
+            ASMX_Error("Too many literals, use LTORG");
+            return locPtr;
+        }
+        if (lpoolLen == 0)
+        {
+            lpoolFirst = locPtr;
+        }
+        lpoolVal[lpoolLen]   = val;
+        lpoolKnown[lpoolLen] = known;
+        lpoolLen++;
+    }
+
+    // the first time through pass 1, the pool's address isn't known yet
+    if (lpoolNum >= lpoolMax)
+    {
+        return locPtr;
+    }
+    return lpoolAddr[lpoolNum] + i * 4;
+}
+
+
+/*
+ *  LPOOL_Waiting - returns the number of literals waiting for the next
+ *                  pool, and the address of the first instruction that
+ *                  used one
+ */
+
+int LPOOL_Waiting(uint32_t *first)
+{
+    *first = lpoolFirst;
+    return lpoolLen;
+}
+
+
+/*
+ *  LPOOL_Flush - puts the waiting literals into bytStr[] after the
+ *                current instruction, if any
+ */
+
+void LPOOL_Flush(void)
+{
+    if (lpoolLen == 0)
+    {
+        return;
+    }
+
+    // longword align the pool
+    int len = abs(instrLen);
+    while ((locPtr + len) & 3)
+    {
+        bytStr[len++] = 0;
+    }
+
+    if (pass == 1)
+    {
+        if (lpoolNum >= lpoolMax)
+        {
+            lpoolMax = lpoolMax ? lpoolMax * 2 : 64;
+            lpoolAddr = (uint32_t *) realloc(lpoolAddr, lpoolMax * sizeof *lpoolAddr);
+        }
+        lpoolAddr[lpoolNum] = locPtr + len;
+    }
+
+    for (int i = 0; i < lpoolLen; i++)
+    {
+        uint32_t val = lpoolVal[i];
+        if (endian == END_BIG)
+        {
+            bytStr[len++] = val >> 24;
+            bytStr[len++] = val >> 16;
+            bytStr[len++] = val >> 8;
+            bytStr[len++] = val;
+        }
+        else
+        {
+            bytStr[len++] = val;
+            bytStr[len++] = val >> 8;
+            bytStr[len++] = val >> 16;
+            bytStr[len++] = val >> 24;
+        }
+    }
+
+    // keep CPU instruction formatting if there was an instruction,
+    // else use generic data formatting
+    instrLen = (instrLen > 0) ? len : -len;
+    lpoolLen = 0;
+    lpoolNum++;
+}
+
+
+// write the waiting literals without putting them in the listing
+static void LPOOL_Dump(void)
+{
+    if (lpoolLen == 0)
+    {
+        return;
+    }
+
+    instrLen = 0;
+    LPOOL_Flush();
+    OBJF_CodeBlock(bytStr, -instrLen);
+    instrLen = 0;
+}
+
+
 // --------------------------------------------------------------
 // instruction format calls
 
@@ -3805,6 +6090,139 @@ void SEG_Switch(SegRec *seg)
 // text I/O
 
 
+/*
+ *  TEXT_LoadFile - returns the contents of a source or include file
+ *
+ *  Files are read into memory once and kept for both passes (and for
+ *  all variants), so a file that is included many times is only read
+ *  from disk once.
+ */
+
+TextFile *TEXT_LoadFile(const char *fname)
+{
+    for (TextFile *p = textTab; p; p = p -> next)
+    {
+        if (strcmp(p -> name, fname) == 0)
+        {
+            return p;
+        }
+    }
+
+    // "-" reads standard input, which can be a pipe since it is only read once
+    FILE *f = stdin;
+    if (strcmp(fname, "-") != 0)
+    {
+        f = fopen(fname, "rb");
+        if (f == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    size_t size = 65536;
+    size_t len  = 0;
+    char *text  = (char *) malloc(size);
+    size_t n;
+    while ((n = fread(text + len, 1, size - len, f)) > 0)
+    {
+        len = len + n;
+        if (len == size)
+        {
+            size = size * 2;
+            text = (char *) realloc(text, size);
+        }
+    }
+    if (f != stdin)
+    {
+        fclose(f);
+    }
+
+    TextFile *p = (TextFile *) malloc(sizeof *p + strlen(fname));
+    strcpy(p -> name, fname);
+    p -> text = text;
+    p -> len  = len;
+    p -> next = textTab;
+    textTab = p;
+
+    return p;
+}
+
+
+void TEXT_Open(TextIn *in, const TextFile *file)
+{
+    in -> p   = file -> text;
+    in -> end = file -> text + file -> len;
+}
+
+
+/*
+ *  TEXT_Prefetch - loads the files named by INCLUDE lines in a file,
+ *                  and the files that they include
+ *
+ *  This is only a guess, since it doesn't know about IF or macros, but
+ *  it lets variants share the include files instead of each one loading
+ *  its own copy.  Files that can't be found are left for the real INCLUDE
+ *  to report.
+ */
+
+void TEXT_Prefetch(const TextFile *file)
+{
+    Str255 word;
+
+    const char *p   = file -> text;
+    const char *end = file -> text + file -> len;
+    while (p < end)
+    {
+        const char *eol = (const char *) memchr(p, '\n', end - p);
+        if (eol == NULL)
+        {
+            eol = end;
+        }
+
+        int len = eol - p;
+        if (len > 255)
+        {
+            len = 255;
+        }
+        memcpy(line, p, len);
+        line[len] = 0;
+        p = eol + 1;
+
+        // skip the label, whitespace, and an optional '.' before the opcode
+        linePtr = line;
+        if (*linePtr != ' ' && *linePtr != '\t')
+        {
+            while (*linePtr && *linePtr != ' ' && *linePtr != '\t')
+            {
+                linePtr++;
+            }
+        }
+        while (*linePtr == ' ' || *linePtr == '\t')
+        {
+            linePtr++;
+        }
+        if (*linePtr == '.')
+        {
+            linePtr++;
+        }
+
+        if (strncasecmp(linePtr, "INCLUDE", 7) == 0 && (linePtr[7] == ' ' || linePtr[7] == '\t'))
+        {
+            linePtr = linePtr + 7;
+            GetFName(word);
+
+            // only scan files the first time they are loaded
+            TextFile *old = textTab;
+            TextFile *inc = TEXT_LoadFile(word);
+            if (inc && textTab != old)
+            {
+                TEXT_Prefetch(inc);
+            }
+        }
+    }
+}
+
+
 int TEXT_OpenInclude(const char *fname)
 {
     if (nInclude == MAX_INCLUDE - 1)
@@ -3812,18 +6230,20 @@ int TEXT_OpenInclude(const char *fname)
         return -1;
     }
 
+    TextFile *file = TEXT_LoadFile(fname);
+    if (file == NULL)
+    {
+        return 0;
+    }
+
     nInclude++;
-    include[nInclude] = NULL;
     incline[nInclude] = 0;
     strcpy(incname[nInclude], fname);
-    include[nInclude] = fopen(fname, "r");
-    if (include[nInclude])
-    {
-        return 1;
-    }
+    incfile[nInclude] = file;
+    TEXT_Open(&include[nInclude], file);
+    statPass[pass].incFiles++;
 
-    nInclude--;
-    return 0;
+    return 1;
 }
 
 
@@ -3834,13 +6254,21 @@ void TEXT_CloseInclude(void)
         return;
     }
 
-    fclose(include[nInclude]);
-    include[nInclude] = NULL;
     nInclude--;
 }
 
 
-int TEXT_ReadLine(FILE *file, char *line, int max)
+static int TEXT_GetChar(TextIn *in)
+{
+    if (in -> p < in -> end)
+    {
+        return (uint8_t) *in -> p++;
+    }
+    return EOF;
+}
+
+
+int TEXT_ReadLine(TextIn *file, char *line, int max)
 {
     int c = 0;
     int len = 0;
@@ -3883,6 +6311,7 @@ int TEXT_ReadLine(FILE *file, char *line, int max)
         if (nInclude >= 0)
         {
             incline[nInclude]++;
+            statPass[pass].incLines++;
         }
         else
         {
@@ -3893,7 +6322,7 @@ int TEXT_ReadLine(FILE *file, char *line, int max)
 
         while (max > 1)
         {
-            c = fgetc(file);
+            c = TEXT_GetChar(file);
             *line = 0;
             switch (c)
             {
@@ -3903,11 +6332,9 @@ int TEXT_ReadLine(FILE *file, char *line, int max)
                 case '\n':
                     return 1;
                 case '\r':
-                    c = fgetc(file);
-                    if (c != '\n')
+                    if (file -> p < file -> end && *file -> p == '\n')
                     {
-                        ungetc(c, file);
-                        c = '\r';
+                        file -> p++;
                     }
                     return 1;
                 default:
@@ -3919,7 +6346,7 @@ int TEXT_ReadLine(FILE *file, char *line, int max)
         }
         while (c != EOF && c != '\n')
         {
-            c = fgetc(file);
+            c = TEXT_GetChar(file);
         }
     }
     return 1;
@@ -3928,15 +6355,26 @@ int TEXT_ReadLine(FILE *file, char *line, int max)
 
 int TEXT_ReadSourceLine(char *line, int max)
 {
-    while (nInclude >= 0)
+    int i = 0;
+
+    STAT_Enter(STAT_READ);
+
+    while (nInclude >= 0 && !i)
     {
-        int i = TEXT_ReadLine(include[nInclude], line, max);
-        if (i) return i;
+        i = TEXT_ReadLine(&include[nInclude], line, max);
+        if (!i)
+        {
+            TEXT_CloseInclude();
+        }
+    }
 
-        TEXT_CloseInclude();
+    if (!i)
+    {
+        i = TEXT_ReadLine(&source, line, max);
     }
 
-    return TEXT_ReadLine(source, line, max);
+    STAT_Leave();
+    return i;
 }
 
 
@@ -3948,6 +6386,8 @@ void TEXT_ListOut(bool showStdErr)
         fputc(12, listing);
     }
 #endif
+    STAT_Enter(STAT_LIST);
+
     Debright(listLine);
 
     if (cl_List)
@@ -3958,8 +6398,10 @@ void TEXT_ListOut(bool showStdErr)
     if (pass == 2 && showStdErr
             && ((errFlag && cl_Err) || (warnFlag && cl_Warn)))
     {
-        fprintf(stderr, "%s\n", listLine);
+        fprintf(stderr, "%s%s\n", errPrefix, listLine);
     }
+
+    STAT_Leave();
 }
 
 
@@ -4421,6 +6863,7 @@ void ASMX_DoOpcode(int typ, int parm)
             instrLen = -instrLen;
             break;
 
+        case OP_FILL:
         case OP_DS:
             val = EXPR_Eval();
 
@@ -4432,6 +6875,13 @@ void ASMX_DoOpcode(int typ, int parm)
 
             oldLine = linePtr;
             token = TOKEN_GetWord(word);
+            if (typ == OP_FILL && token != ',')
+            {
+                // FILL always needs the data
+                linePtr = oldLine;
+                TOKEN_Comma();
+                break;
+            }
             if (token == ',')
             {
                 // DS len,data (with initialization)
@@ -4452,18 +6902,22 @@ void ASMX_DoOpcode(int typ, int parm)
                     ASMX_Error("Invalid negative DS size");
                     break;
                 }
-                if (val*parm > MAX_BYTSTR)
+                if ((uint32_t) val > UINT32_MAX / parm)
                 {
-                    sprintf(s, "String too long (max %d bytes)", MAX_BYTSTR);
-                    ASMX_Error(s);
+                    ASMX_Error("Operand out of range");
                     break;
                 }
 
+                // FILL, or data too big for bytStr[], gets streamed
+                // to the object file from a single copy of the data
+                bool stream = (typ == OP_FILL || (uint32_t) val > (uint32_t) (MAX_BYTSTR / parm));
+                int  count  = stream ? 1 : val;
+
                 if (parm == 1)
                 {
                     // DS.B
                     // copy the byte into every location
-                    for (int i = 0; i < val; i++)
+                    for (int i = 0; i < count; i++)
                     {
                         bytStr[i] = n;
                     }
@@ -4478,7 +6932,7 @@ void ASMX_DoOpcode(int typ, int parm)
                     }
 
                     // copy words/longwords, respecting current endianness
-                    for (int i = 0; i < val*parm; i += parm)
+                    for (int i = 0; i < count*parm; i += parm)
                     {
                         if (endian == END_BIG)
                         {
@@ -4512,6 +6966,24 @@ void ASMX_DoOpcode(int typ, int parm)
                     }
                 }
 
+                if (stream)
+                {
+                    if (pass == 2)
+                    {
+                        showAddr = false;
+
+                        // "XXXX  (XXXX)"
+                        char *p = LIST_Loc(locPtr);
+                        *p++ = ' ';
+                        *p++ = '(';
+                        p = LIST_Addr(p, (uint32_t) val * parm);
+                        *p++ = ')';
+                    }
+
+                    OBJF_CodeFill(bytStr, parm, val);
+                    break;
+                }
+
                 // add size to the location pointer
                 instrLen = -val * parm;
                 break;
@@ -4746,6 +7218,10 @@ void ASMX_DoOpcode(int typ, int parm)
             OBJF_AddLocPtr(val);
             break;
 
+        case OP_LTORG:
+            LPOOL_Flush();
+            break;
+
         case OP_END:
             if (nInclude >= 0)
             {
@@ -4753,6 +7229,7 @@ void ASMX_DoOpcode(int typ, int parm)
             }
             else
             {
+                LPOOL_Flush();
                 oldLine = linePtr;
                 if (TOKEN_GetWord(word))
                 {
@@ -4910,6 +7387,7 @@ void ASMX_DoLabelOp(int typ, int parm, char *labl)
                 SegRec *seg = SEG_Find(word); // find segment storage and create if necessary
                 if (!seg) seg = SEG_Add(word);
 //              seg -> gen = parm;      // copy gen flag from parameter
+                LPOOL_Dump();   // literals stay in the segment that used them
                 SEG_Switch(seg);
                 SYM_Def(labl, locPtr, false, false);
                 showAddr = true;
@@ -5169,7 +7647,7 @@ void ASMX_DoLabelOp(int typ, int parm, char *labl)
                     switch (typ)
                     {
                         case OP_IF:
-                            if (pass == 1)
+                            if (pass == 1 && relaxIter == 1)
                             {
                                 AddMacroLine(macro, line);
                             }
@@ -5177,7 +7655,7 @@ void ASMX_DoLabelOp(int typ, int parm, char *labl)
                             break;
 
                         case o_ENDIF:
-                            if (pass == 1)
+                            if (pass == 1 && relaxIter == 1)
                             {
                                 AddMacroLine(macro, line);
                             }
@@ -5196,14 +7674,14 @@ void ASMX_DoLabelOp(int typ, int parm, char *labl)
                             break;
 
                         case OP_ENDM:
-                            if (pass == 1 && labl[0])
+                            if (pass == 1 && relaxIter == 1 && labl[0])
                             {
                                 AddMacroLine(macro, labl);
                             }
                             break;
 
                         default:
-                            if (pass == 1)
+                            if (pass == 1 && relaxIter == 1)
                             {
                                 AddMacroLine(macro, line);
                             }
@@ -5518,10 +7996,7 @@ void ASMX_DoLabelOp(int typ, int parm, char *labl)
                     if (n > 0)
                     {
                         // write data out to the object file
-                        for (int i = 0; i < n; i++)
-                        {
-                            OBJF_CodeOut(bytStr[i]);
-                        }
+                        OBJF_CodeBlock(bytStr, n);
                         val = val + n;
                     }
                 }
@@ -5592,6 +8067,75 @@ void ASMX_DoLabelOp(int typ, int parm, char *labl)
 }
 
 
+/*
+ *  ASMX_IsCondLine - quick check for an IF/ELSE/ELSIF/ENDIF line
+ *
+ *  This is used to skip lines inside a failed IF block without copying
+ *  them to the listing line or parsing their labels and opcodes.
+ */
+
+// checks if an opcode is IF, ELSE, ELSIF, or ENDIF
+static bool ASMX_IsCondWord(const char *p)
+{
+    char    word[8];
+    int     n = 0;
+
+    // get up to 5 chars of the opcode
+    while (n < 6 && isalphanum(*p))
+    {
+        word[n++] = toupper(*p++);
+    }
+    if (n > 5 || isalphanum(*p) || *p == '.')
+    {
+        return false;
+    }
+    word[n] = 0;
+
+    return strcmp(word, "IF")    == 0 || strcmp(word, "ELSE")  == 0 ||
+           strcmp(word, "ELSIF") == 0 || strcmp(word, "ENDIF") == 0;
+}
+
+
+static bool ASMX_IsCondLine(const char *p)
+{
+    // skip initial formfeeds
+    while (*p == 12)
+    {
+        p++;
+    }
+
+    // ".IF" etc. in column 1 is a pseudo-op, but other ".name" is a temp label
+    if (*p == '.' && ASMX_IsCondWord(p + 1))
+    {
+        return true;
+    }
+
+    // skip label, including '.' and '@' temp labels
+    while (isalphanum(*p) || *p == '$' || *p == '@' || *p == '.')
+    {
+        p++;
+    }
+    if (*p == ':' && p[1] != '=')
+    {
+        p++;
+    }
+
+    // skip whitespace before opcode
+    while (*p == 12 || *p == '\t' || *p == ' ')
+    {
+        p++;
+    }
+
+    // allow pseudo-ops to be invoked as ".OP"
+    if (*p == '.')
+    {
+        p++;
+    }
+
+    return ASMX_IsCondWord(p);
+}
+
+
 static void ASMX_DoLine()
 {
     Str255      labl;
@@ -5613,6 +8157,13 @@ static void ASMX_DoLine()
     showAddr     = false;
     listThisLine = listFlag;
     firstLine    = true;
+
+    // inside a failed IF block, only the conditionals need to be looked at
+    if (!(condState[condLevel] & condTRUE) && !ASMX_IsCondLine(line))
+    {
+        return;
+    }
+
     TEXT_CopyListLine();
 
     // skip initial formfeeds
@@ -5849,6 +8400,7 @@ static void ASMX_DoLine()
 #endif
 
                     GetMacParms(macro);
+                    statPass[pass].macros++;
 
                     showAddr = true;
                     SYM_Def(labl, locPtr, false, false);
@@ -6030,120 +8582,377 @@ static void ASMX_DoLine()
                 }
             }
 
-            if (listThisLine && (errFlag || listMacFlag || !macLineFlag))
-            {
-                TEXT_ListOut(firstLine);
-            }
-        }
+            if (listThisLine && (errFlag || listMacFlag || !macLineFlag))
+            {
+                TEXT_ListOut(firstLine);
+            }
+        }
+    }
+}
+
+
+static void ASMX_DoPass()
+{
+    Str255      opcode;
+    int         typ;
+    int         parm;
+
+    TEXT_Open(&source, srcFile); // rewind source file
+    sourceEnd = false;
+    lastLabl[0] = 0;
+    subrLabl[0] = 0;
+
+    if (cl_edtasm)
+    {
+        fprintf(stderr, "Pass %d\n", pass);
+
+        if (cl_ListP1)
+        {
+            fprintf(listing, "Pass %d\n", pass);
+        }
+    }
+
+    errCount      = 0;
+    relaxSite     = 0;
+    lpoolLen      = 0;
+    lpoolNum      = 0;
+    condLevel     = 0;
+    condState[condLevel] = condTRUE; // top level always true
+    listFlag      = true;
+    listMacFlag   = false;
+    expandHexFlag = true;
+    symtabFlag    = true;
+    tempSymFlag   = true;
+    exactFlag     = false;
+    linenum       = 0;
+    macLevel      = 0;
+    macUniqueID   = 0;
+    macCurrentID[0] = 0;
+    curAsm        = NULL;
+    endian        = END_UNKNOWN;
+    opcdTab       = NULL;
+    listWid       = LIST_24;
+    addrWid       = ADDR_32;
+    wordSize      = 8;
+    opts          = 0;
+    SetWordSize(wordSize);
+    SetCPU(defCPU);
+    addrMax       = addrWid;
+
+    // reset all code pointers
+    OBJF_CodeAbsOrg(0);
+    SegRec *seg = segTab;
+    while (seg)
+    {
+        seg -> cod = 0;
+        seg -> loc = 0;
+        seg = seg -> next;
+    }
+    curSeg = nullSeg;
+
+    if (pass == 2) OBJF_CodeHeader(cl_SrcName);
+
+    PassInit();
+    int i = TEXT_ReadSourceLine(line, sizeof(line));
+    while (i && !sourceEnd)
+    {
+        statPass[pass].lines++;
+        PROF_Line();
+        ASMX_DoLine();
+        i = TEXT_ReadSourceLine(line, sizeof(line));
+    }
+
+    if (condLevel != 0)
+    {
+        ASMX_Error("IF block without ENDIF");
+    }
+
+    LPOOL_Dump();   // in case there was no END
+
+    if (pass == 2) OBJF_CodeEnd();
+
+    // Put the lines after the END statement into the listing file
+    // while still checking for listing control statements.  Ignore
+    // any lines which have invalid syntax, etc., because whatever
+    // is found after an END statement should esentially be ignored.
+
+    if (pass == 2 || cl_ListP1)
+    {
+        while (i)
+        {
+            listThisLine = listFlag;
+            TEXT_CopyListLine();
+
+            if (line[0]==' ' || line[0]=='\t')          // ignore labels (this isn't the right way)
+            {
+                MacroRec    *macro;
+                GetFindOpcode(opcode, &typ, &parm, &macro);
+                if (typ == OP_LIST || typ == OP_OPT)
+                {
+                    ASMX_DoLabelOp(typ, parm, "");
+                }
+            }
+
+            if (listThisLine)
+            {
+                TEXT_ListOut(true);
+            }
+
+            i = TEXT_ReadSourceLine(line, sizeof(line));
+        }
+    }
+}
+
+// --------------------------------------------------------------
+// asynchronous output
+//
+// With --async-io, listing and object files are written by a background
+// thread for each file, so a slow disk or network filesystem doesn't stall
+// assembly.  The FILE that the assembler writes to is a glibc cookie stream
+// with a large buffer.  Each time the buffer fills, it is copied into a slot
+// of a single-producer single-consumer ring, and the writer thread writes it
+// to the real file.  The ring is a blocking queue: two semaphores count the
+// full and empty slots, so the assembler only waits when all slots are
+// full.  Seeks (for binary object files) are queued in the same ring to
+// keep them in order.  Any write error is reported when the file is closed.
+
+#ifdef ASYNC_IO
+
+enum
+{
+    ASYNC_SLOTS = 8,            // number of buffers in the ring
+    ASYNC_BLOCK = 65536,        // size of each buffer
+};
+
+enum { ASYNC_DATA, ASYNC_SEEK, ASYNC_CLOSE };   // types of ring slots
+
+struct AsyncSlot
+{
+    int                 type;       // ASYNC_DATA, ASYNC_SEEK, or ASYNC_CLOSE
+    size_t              len;        // length of data
+    off64_t             pos;        // file position for ASYNC_SEEK
+    char                data[ASYNC_BLOCK];
+};
+
+struct AsyncFile
+{
+    FILE                *file;      // real output file
+    pthread_t           thread;     // writer thread
+    sem_t               full;       // number of slots ready to be written
+    sem_t               empty;      // number of slots free to be filled
+    unsigned            tail;       // next slot to be filled by the assembler
+    off64_t             pos;        // current file position
+    off64_t             size;       // current file size
+    int                 err;        // errno of first write error, set by thread
+    struct AsyncSlot    slot[ASYNC_SLOTS];
+    char                buf[ASYNC_BLOCK];   // stdio buffer of the cookie stream
+};
+typedef struct AsyncFile AsyncFile;
+
+
+static void *ASYNC_Thread(void *arg)
+{
+    AsyncFile *af = (AsyncFile *) arg;
+    unsigned head = 0;      // next slot to be written
+    bool done = false;
+
+    while (!done)
+    {
+        // the semaphore orders this after the slot was filled
+        sem_wait(&af -> full);
+        struct AsyncSlot *slot = &af -> slot[head % ASYNC_SLOTS];
+
+        if (af -> err == 0)
+        {
+            switch (slot -> type)
+            {
+                case ASYNC_DATA:
+                    if (fwrite(slot -> data, 1, slot -> len, af -> file) != slot -> len)
+                    {
+                        af -> err = errno ? errno : EIO;
+                    }
+                    break;
+
+                case ASYNC_SEEK:
+                    if (fseeko(af -> file, slot -> pos, SEEK_SET) != 0)
+                    {
+                        af -> err = errno ? errno : EIO;
+                    }
+                    break;
+            }
+        }
+        done = (slot -> type == ASYNC_CLOSE);
+
+        head++;
+        sem_post(&af -> empty);
+    }
+
+    return NULL;
+}
+
+
+// get a free slot, waiting for the thread if the ring is full
+static struct AsyncSlot *ASYNC_GetSlot(AsyncFile *af)
+{
+    sem_wait(&af -> empty);
+
+    return &af -> slot[af -> tail % ASYNC_SLOTS];
+}
+
+
+// pass a filled slot to the thread
+static void ASYNC_PutSlot(AsyncFile *af)
+{
+    af -> tail++;
+    sem_post(&af -> full);
+}
+
+
+static ssize_t ASYNC_Write(void *cookie, const char *buf, size_t size)
+{
+    AsyncFile *af = (AsyncFile *) cookie;
+    size_t n = size;
+
+    while (n)
+    {
+        struct AsyncSlot *slot = ASYNC_GetSlot(af);
+        size_t len = n < ASYNC_BLOCK ? n : ASYNC_BLOCK;
+
+        slot -> type = ASYNC_DATA;
+        slot -> len  = len;
+        memcpy(slot -> data, buf, len);
+        ASYNC_PutSlot(af);
+
+        buf = buf + len;
+        n   = n - len;
+    }
+
+    af -> pos = af -> pos + size;
+    if (af -> pos > af -> size)
+    {
+        af -> size = af -> pos;
+    }
+
+    return size;
+}
+
+
+static int ASYNC_Seek(void *cookie, off64_t *offset, int whence)
+{
+    AsyncFile *af = (AsyncFile *) cookie;
+    off64_t pos = *offset;
+
+    switch (whence)
+    {
+        case SEEK_CUR:
+            pos = pos + af -> pos;
+            break;
+        case SEEK_END:
+            pos = pos + af -> size;
+            break;
+    }
+    if (pos < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // ftell() seeks to the current position, so only queue real seeks
+    if (pos != af -> pos)
+    {
+        struct AsyncSlot *slot = ASYNC_GetSlot(af);
+        slot -> type = ASYNC_SEEK;
+        slot -> pos  = pos;
+        ASYNC_PutSlot(af);
+        af -> pos = pos;
     }
+
+    *offset = pos;
+    return 0;
 }
 
 
-static void ASMX_DoPass()
+static int ASYNC_Close(void *cookie)
 {
-    Str255      opcode;
-    int         typ;
-    int         parm;
+    AsyncFile *af = (AsyncFile *) cookie;
 
-    fseek(source, 0, SEEK_SET); // rewind source file
-    sourceEnd = false;
-    lastLabl[0] = 0;
-    subrLabl[0] = 0;
+    struct AsyncSlot *slot = ASYNC_GetSlot(af);
+    slot -> type = ASYNC_CLOSE;
+    ASYNC_PutSlot(af);
+    pthread_join(af -> thread, NULL);
 
-    if (cl_edtasm)
+    int err = af -> err;
+    if (fclose(af -> file) != 0 && err == 0)
     {
-        fprintf(stderr, "Pass %d\n", pass);
-
-        if (cl_ListP1)
-        {
-            fprintf(listing, "Pass %d\n", pass);
-        }
+        err = errno ? errno : EIO;
     }
+    sem_destroy(&af -> full);
+    sem_destroy(&af -> empty);
+    free(af);
 
-    errCount      = 0;
-    condLevel     = 0;
-    condState[condLevel] = condTRUE; // top level always true
-    listFlag      = true;
-    listMacFlag   = false;
-    expandHexFlag = true;
-    symtabFlag    = true;
-    tempSymFlag   = true;
-    exactFlag     = false;
-    linenum       = 0;
-    macLevel      = 0;
-    macUniqueID   = 0;
-    macCurrentID[0] = 0;
-    curAsm        = NULL;
-    endian        = END_UNKNOWN;
-    opcdTab       = NULL;
-    listWid       = LIST_24;
-    addrWid       = ADDR_32;
-    wordSize      = 8;
-    opts          = 0;
-    SetWordSize(wordSize);
-    SetCPU(defCPU);
-    addrMax       = addrWid;
-
-    // reset all code pointers
-    OBJF_CodeAbsOrg(0);
-    SegRec *seg = segTab;
-    while (seg)
+    if (err)
     {
-        seg -> cod = 0;
-        seg -> loc = 0;
-        seg = seg -> next;
+        errno = err;
+        return -1;
     }
-    curSeg = nullSeg;
+    return 0;
+}
 
-    if (pass == 2) OBJF_CodeHeader(cl_SrcName);
+#endif // ASYNC_IO
 
-    PassInit();
-    int i = TEXT_ReadSourceLine(line, sizeof(line));
-    while (i && !sourceEnd)
-    {
-        ASMX_DoLine();
-        i = TEXT_ReadSourceLine(line, sizeof(line));
-    }
 
-    if (condLevel != 0)
-    {
-        ASMX_Error("IF block without ENDIF");
-    }
+// open an output file, with a background writer thread if --async-io was used
+static FILE *ASYNC_Open(const char *fname, const char *mode)
+{
+    FILE *f = fopen(fname, mode);
 
-    if (pass == 2) OBJF_CodeEnd();
+#ifdef ASYNC_IO
+    if (f && cl_AsyncIO)
+    {
+        AsyncFile *af = (AsyncFile *) malloc(sizeof *af);
+        af -> file = f;
+        af -> pos  = 0;
+        af -> size = 0;
+        af -> err  = 0;
+        af -> tail = 0;
+        sem_init(&af -> full,  0, 0);
+        sem_init(&af -> empty, 0, ASYNC_SLOTS);
 
-    // Put the lines after the END statement into the listing file
-    // while still checking for listing control statements.  Ignore
-    // any lines which have invalid syntax, etc., because whatever
-    // is found after an END statement should esentially be ignored.
+        cookie_io_functions_t funcs = { NULL, ASYNC_Write, ASYNC_Seek, ASYNC_Close };
+        FILE *cf = fopencookie(af, "w", funcs);
+        if (cf && pthread_create(&af -> thread, NULL, ASYNC_Thread, af) == 0)
+        {
+            setvbuf(cf, af -> buf, _IOFBF, sizeof af -> buf);
+            return cf;
+        }
 
-    if (pass == 2 || cl_ListP1)
-    {
-        while (i)
+        // fall back to writing the file directly
+        if (cf)
         {
-            listThisLine = listFlag;
-            TEXT_CopyListLine();
+            fclose(cf);
+        }
+        sem_destroy(&af -> full);
+        sem_destroy(&af -> empty);
+        free(af);
+    }
+#endif
 
-            if (line[0]==' ' || line[0]=='\t')          // ignore labels (this isn't the right way)
-            {
-                MacroRec    *macro;
-                GetFindOpcode(opcode, &typ, &parm, &macro);
-                if (typ == OP_LIST || typ == OP_OPT)
-                {
-                    ASMX_DoLabelOp(typ, parm, "");
-                }
-            }
+    return f;
+}
 
-            if (listThisLine)
-            {
-                TEXT_ListOut(true);
-            }
 
-            i = TEXT_ReadSourceLine(line, sizeof(line));
-        }
+// close an output file, reporting any write error
+static bool ASYNC_CloseFile(FILE *f, const char *fname)
+{
+    if (fclose(f) != 0)
+    {
+        fprintf(stderr, "Error writing output file '%s': %s\n", fname, strerror(errno));
+        return false;
     }
+    return true;
 }
 
+
 // --------------------------------------------------------------
 // initialization and parameters
 
@@ -6161,6 +8970,7 @@ static void ASMX_usage(void)
     fprintf(stderr, "\n");
     fprintf(stderr, "Usage:\n");
     fprintf(stderr, "    %s [options] srcfile\n", progname);
+    fprintf(stderr, "    %s [options] -        (read source from standard input)\n", progname);
     fprintf(stderr, "\n");
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "    --                  end of options\n");
@@ -6179,6 +8989,24 @@ static void ASMX_usage(void)
     fprintf(stderr, "    -t [reclen]         output object file in TRSDOS (implies -C Z80)\n");
     fprintf(stderr, "    -T [reclen]         output object file as TRS-80 cassette file (implies -C Z80)\n");
     fprintf(stderr, "    -c                  send object code to stdout\n");
+    fprintf(stderr, "    --sorted            write object code in ascending address order\n");
+    fprintf(stderr, "    --reclen n          data bytes per hex or S-record line (default %d)\n", IHEX_SIZE);
+    fprintf(stderr, "    --stats             show performance statistics\n");
+    fprintf(stderr, "    --stats-json file   write performance statistics to a JSON file\n");
+    fprintf(stderr, "    --profile file      write time profile by include file and macro (folded stacks)\n");
+    fprintf(stderr, "    --profile-bytes file  write object code size profile by include file and macro\n");
+    fprintf(stderr, "    --variant name:defs assemble a variant with comma-separated -d defines\n");
+    fprintf(stderr, "    --variants file     assemble the variants listed in a file, one name:defs per line\n");
+    fprintf(stderr, "    --jobs n            max number of variants to assemble at the same time\n");
+    fprintf(stderr, "    --async-io          write listing and object files from a background thread\n");
+    fprintf(stderr, "    --symmap file       write a binary symbol map for debuggers and emulators\n");
+    fprintf(stderr, "    --linetab file      write a table of source file and line for each address\n");
+    fprintf(stderr, "    --xref file         write a cross reference of symbol definitions and references\n");
+    fprintf(stderr, "    --sizes file        write object code size by label, segment, and file\n");
+    fprintf(stderr, "    --sizes-diff file   show size changes from a previous --sizes report\n");
+    fprintf(stderr, "    --sizes-limit n     fail if the total size grew by more than n bytes\n");
+    fprintf(stderr, "    --relax             repeat the first pass to use short instruction forms for forward references\n");
+    fprintf(stderr, "    --relax-report file write the instruction forms chosen by --relax (implies --relax)\n");
     fprintf(stderr, "    -C cputype          specify default CPU type (currently ");
     if (defCPU[0])
     {
@@ -6193,20 +9021,344 @@ static void ASMX_usage(void)
 }
 
 
-static void getopts(int argc, char * const argv[])
+// long options, returned by getopt_long() as values after all single-char options
+enum
+{
+    LOPT_SORTED = 256,
+    LOPT_RECLEN,
+    LOPT_STATS,
+    LOPT_STATS_JSON,
+    LOPT_PROFILE,
+    LOPT_PROFILE_BYTES,
+    LOPT_VARIANT,
+    LOPT_VARIANTS,
+    LOPT_JOBS,
+    LOPT_ASYNC_IO,
+    LOPT_SYMMAP,
+    LOPT_LINETAB,
+    LOPT_XREF,
+    LOPT_SIZES,
+    LOPT_SIZES_DIFF,
+    LOPT_SIZES_LIMIT,
+    LOPT_RELAX,
+    LOPT_RELAX_REPORT,
+};
+
+static const struct option longopts[] =
+{
+    { "sorted",        no_argument,       NULL, LOPT_SORTED },
+    { "reclen",        required_argument, NULL, LOPT_RECLEN },
+    { "stats",         no_argument,       NULL, LOPT_STATS },
+    { "stats-json",    required_argument, NULL, LOPT_STATS_JSON },
+    { "profile",       required_argument, NULL, LOPT_PROFILE },
+    { "profile-bytes", required_argument, NULL, LOPT_PROFILE_BYTES },
+    { "variant",       required_argument, NULL, LOPT_VARIANT },
+    { "variants",      required_argument, NULL, LOPT_VARIANTS },
+    { "jobs",          required_argument, NULL, LOPT_JOBS },
+    { "async-io",      no_argument,       NULL, LOPT_ASYNC_IO },
+    { "symmap",        required_argument, NULL, LOPT_SYMMAP },
+    { "linetab",       required_argument, NULL, LOPT_LINETAB },
+    { "xref",          required_argument, NULL, LOPT_XREF },
+    { "sizes",         required_argument, NULL, LOPT_SIZES },
+    { "sizes-diff",    required_argument, NULL, LOPT_SIZES_DIFF },
+    { "sizes-limit",   required_argument, NULL, LOPT_SIZES_LIMIT },
+    { "relax",         no_argument,       NULL, LOPT_RELAX },
+    { "relax-report",  required_argument, NULL, LOPT_RELAX_REPORT },
+    { NULL,            0,                 NULL, 0 }
+};
+
+
+// get the object output that format options apply to, creating it if needed
+static ObjRec *OBJF_OptObj(void)
+{
+    if (cl_ObjOpt == NULL)
+    {
+        cl_ObjOpt = (ObjRec *) calloc(1, sizeof(ObjRec));
+        cl_ObjOpt->type   = OBJ_HEX;
+        cl_ObjOpt->trslen = TRS_BUF_MAX;
+    }
+
+    return cl_ObjOpt;
+}
+
+
+// get the object output for a format option, which can only have one format
+static ObjRec *OBJF_FmtObj(const char *opt)
+{
+    ObjRec *obj = OBJF_OptObj();
+
+    if (obj->type != OBJ_HEX)
+    {
+        fprintf(stderr, "%s: Conflicting options: %s is a second format for the same object file\n", progname, opt);
+        ASMX_usage();
+    }
+
+    return obj;
+}
+
+
+// add the object output from format options to the end of the object list
+static ObjRec *OBJF_AddObj(void)
+{
+    ObjRec *obj = OBJF_OptObj();
+    cl_ObjOpt = NULL;
+
+    if (objTab == NULL)
+    {
+        objTab = obj;
+    }
+    else
+    {
+        ObjRec *p = objTab;
+        while (p->next)
+        {
+            p = p->next;
+        }
+        p->next = obj;
+    }
+
+    return obj;
+}
+
+
+// define a label from a "label[[:]=value]" command line option
+static void ASMX_DefineOpt(const char *def)
 {
-    int     ch;
-    int     val;
     Str255  labl, word;
+    int     val;
     bool    setSym;
     int     token;
     int     neg;
 
-    while ((ch = getopt(argc, argv, "ew19t:T:b:cd:l:o:s:C:@?")) != -1)
+    errFlag = false;
+    strncpy(line, def, 255);
+    linePtr = line;
+    TOKEN_GetWord(labl);
+    val = 0;
+    setSym = false;
+    token = TOKEN_GetWord(word);
+    if (token == ':')
+    {
+        // allow ":="
+        setSym = true;
+        token = TOKEN_GetWord(word);
+    }
+    if (token == '=')
+    {
+        neg = 1;
+        if (TOKEN_GetWord(word) == '-')
+        {
+            neg = -1;
+            TOKEN_GetWord(word);
+        }
+        val = neg * EvalNum(word);
+        if (errFlag)
+        {
+            fprintf(stderr, "%s: Invalid number '%s' in -d option\n", progname, word);
+            ASMX_usage();
+        }
+    }
+    SYM_Def(labl, val, setSym, !setSym);
+}
+
+
+// --------------------------------------------------------------
+// variants
+
+struct VarRec
+{
+    struct VarRec   *next;          // next variant
+    char            *defs;          // comma-separated label[[:]=value] definitions
+    char            name[1];        // variant name, storage = 1 + length
+} *varTab = NULL;               // pointer to first variant
+typedef struct VarRec VarRec;
+
+
+// add a variant from a "name:label[=value],..." string
+static void VAR_Add(const char *spec)
+{
+    const char *colon = strchr(spec, ':');
+    int len = colon ? colon - spec : (int) strlen(spec);
+
+    if (len == 0)
+    {
+        fprintf(stderr, "%s: Missing variant name in '%s'\n", progname, spec);
+        ASMX_usage();
+    }
+
+    VarRec *p = (VarRec *) malloc(sizeof *p + len);
+    memcpy(p -> name, spec, len);
+    p -> name[len] = 0;
+    p -> defs = strdup(colon ? colon + 1 : "");
+    p -> next = NULL;
+
+    // keep variants in command line order
+    VarRec **q = &varTab;
+    while (*q)
+    {
+        q = &(*q) -> next;
+    }
+    *q = p;
+}
+
+
+// add variants from a file with one "name:label[=value],..." per line
+static void VAR_AddFile(const char *fname)
+{
+    Str255 s;
+
+    FILE *f = fopen(fname, "r");
+    if (f == NULL)
+    {
+        fprintf(stderr, "%s: Unable to open variants file '%s'\n", progname, fname);
+        exit(1);
+    }
+
+    while (fgets(s, sizeof s, f))
+    {
+        Debleft(s);
+        s[strcspn(s, "\r\n")] = 0;
+        Debright(s);
+        if (s[0] && s[0] != ';' && s[0] != '#')
+        {
+            VAR_Add(s);
+        }
+    }
+
+    fclose(f);
+}
+
+
+// insert ".name" in front of the extension of a file name
+static void VAR_FileName(char *fname, const char *name)
+{
+    Str255 ext;
+
+    if (fname[0] == 0)
+    {
+        return;
+    }
+
+    char *dot   = strrchr(fname, '.');
+    char *slash = strrchr(fname, '/');
+    if (dot == NULL || (slash && dot < slash) || dot == fname)
+    {
+        dot = fname + strlen(fname);
+    }
+
+    strcpy(ext, dot);
+    snprintf(dot, 255 - (dot - fname), ".%s%s", name, ext);
+}
+
+
+static void getopts(int argc, char * const argv[])
+{
+    ObjRec  *obj;
+    int     ch;
+    int     val;
+    Str255  word;
+    int     token;
+
+    while ((ch = getopt_long(argc, argv, "ew19t:T:b:cd:l:o:s:C:@?", longopts, NULL)) != -1)
     {
         errFlag = false;
         switch (ch)
         {
+            case LOPT_SORTED:
+                cl_Sorted = true;
+                break;
+
+            case LOPT_RECLEN:
+                val = EvalNum(optarg);
+                if (errFlag || val < 1 || val > MAX_RECLEN)
+                {
+                    fprintf(stderr, "%s: Invalid record length '%s', must be 1 to %d\n", progname, optarg, MAX_RECLEN);
+                    ASMX_usage();
+                }
+                cl_RecLen = val;
+                break;
+
+            case LOPT_STATS:
+                cl_Stats     = true;
+                cl_StatsText = true;
+                break;
+
+            case LOPT_STATS_JSON:
+                cl_Stats = true;
+                strncpy(cl_StatsName, optarg, 255);
+                break;
+
+            case LOPT_PROFILE:
+                profOn = true;
+                strncpy(cl_ProfName, optarg, 255);
+                break;
+
+            case LOPT_PROFILE_BYTES:
+                profOn = true;
+                strncpy(cl_ProfBytesName, optarg, 255);
+                break;
+
+            case LOPT_VARIANT:
+                VAR_Add(optarg);
+                break;
+
+            case LOPT_VARIANTS:
+                VAR_AddFile(optarg);
+                break;
+
+            case LOPT_JOBS:
+                val = EvalNum(optarg);
+                if (errFlag || val < 1)
+                {
+                    fprintf(stderr, "%s: Invalid number of jobs '%s'\n", progname, optarg);
+                    ASMX_usage();
+                }
+                cl_Jobs = val;
+                break;
+
+            case LOPT_ASYNC_IO:
+                cl_AsyncIO = true;
+                break;
+
+            case LOPT_SYMMAP:
+                strncpy(cl_SymMapName, optarg, 255);
+                break;
+
+            case LOPT_LINETAB:
+                strncpy(cl_LineTabName, optarg, 255);
+                break;
+
+            case LOPT_XREF:
+                strncpy(cl_XrefName, optarg, 255);
+                break;
+
+            case LOPT_SIZES:
+                strncpy(cl_SizesName, optarg, 255);
+                break;
+
+            case LOPT_SIZES_DIFF:
+                strncpy(cl_SizesDiffName, optarg, 255);
+                break;
+
+            case LOPT_SIZES_LIMIT:
+                val = EvalNum(optarg);
+                if (errFlag || val < 0)
+                {
+                    fprintf(stderr, "%s: Invalid size limit '%s'\n", progname, optarg);
+                    ASMX_usage();
+                }
+                cl_SizesLimit = val;
+                break;
+
+            case LOPT_RELAX:
+                relaxFlag = true;
+                break;
+
+            case LOPT_RELAX_REPORT:
+                relaxFlag = true;
+                strncpy(cl_RelaxName, optarg, 255);
+                break;
+
             case 'e':
                 cl_Err = true;
                 break;
@@ -6220,12 +9372,14 @@ static void getopts(int argc, char * const argv[])
                 break;
 
             case '9': // -9 option is deprecated
-                cl_S9type  = 9;
-                cl_ObjType = OBJ_S9;
+                obj = OBJF_FmtObj("-9");
+                obj->s9type = 9;
+                obj->type   = OBJ_S9;
                 break;
 
             case 't':
-                cl_ObjType = OBJ_TRSDOS;
+                obj = OBJF_FmtObj("-t");
+                obj->type = OBJ_TRSDOS;
                 strcpy(defCPU, "Z80");
 
                 if (!isdigit(optarg[0]))
@@ -6244,12 +9398,13 @@ static void getopts(int argc, char * const argv[])
                         ASMX_usage();
                     }
                     if (1 <= val && val <= TRS_BUF_MAX)
-                        cl_trslen = val;
+                        obj->trslen = val;
                 }
                 break;
 
             case 'T':
-                cl_ObjType = OBJ_TRSCAS;
+                obj = OBJF_FmtObj("-T");
+                obj->type = OBJ_TRSCAS;
                 strcpy(defCPU, "Z80");
 
                 if (!isdigit(optarg[0]))
@@ -6268,33 +9423,35 @@ static void getopts(int argc, char * const argv[])
                         ASMX_usage();
                     }
                     if (1 <= val && val <= TRS_BUF_MAX)
-                        cl_trslen = val;
+                        obj->trslen = val;
                 }
                 break;
 
             case 's':
+                snprintf(word, sizeof word, "-s%s", optarg);
+                obj = OBJF_FmtObj(word);
                 if (optarg[0] == '9' && optarg[1] == 0)
                 {
-                    cl_S9type = 9;
+                    obj->s9type = 9;
                 }
                 else if (optarg[0] == '1' && optarg[1] == '9' && optarg[2] == 0)
                 {
-                    cl_S9type = 19;
+                    obj->s9type = 19;
                 }
                 else if (optarg[0] == '2' && optarg[1] == '8' && optarg[2] == 0)
                 {
-                    cl_S9type = 28;
+                    obj->s9type = 28;
                 }
                 else if (optarg[0] == '3' && optarg[1] == '7' && optarg[2] == 0)
                 {
-                    cl_S9type = 37;
+                    obj->s9type = 37;
                 }
                 else
                 {
                     fprintf(stderr, "%s: Invalid S-record type '%s'\n", progname, optarg);
                     ASMX_usage();
                 }
-                cl_ObjType = OBJ_S9;
+                obj->type = OBJ_S9;
                 break;
 
             case '@':
@@ -6302,9 +9459,10 @@ static void getopts(int argc, char * const argv[])
                 break;
 
             case 'b':
-                cl_ObjType = OBJ_BIN;
-                cl_Binbase = 0;
-                cl_Binend = 0xFFFFFFFF;
+                obj = OBJF_FmtObj("-b");
+                obj->type    = OBJ_BIN;
+                obj->binbase = 0;
+                obj->binend  = 0xFFFFFFFF;
 
                 if (!isdigit(optarg[0]))
                 {
@@ -6324,7 +9482,7 @@ static void getopts(int argc, char * const argv[])
                         fprintf(stderr, "%s: Invalid start argument '%s' for -b\n", progname, word);
                         ASMX_usage();
                     }
-                    cl_Binbase = EvalNum(word);
+                    obj->binbase = EvalNum(word);
                     if (errFlag)
                     {
                         fprintf(stderr, "%s: Invalid number '%s' in -b option\n", progname, word);
@@ -6346,7 +9504,7 @@ static void getopts(int argc, char * const argv[])
                             fprintf(stderr, "%s: Invalid end argument '%s' for -b\n", progname, word);
                             ASMX_usage();
                         }
-                        cl_Binend = EvalNum(word);
+                        obj->binend = EvalNum(word);
                         if (errFlag)
                         {
                             fprintf(stderr, "%s: Invalid number '%s' in -b option\n", progname, word);
@@ -6362,38 +9520,16 @@ static void getopts(int argc, char * const argv[])
                     fprintf(stderr, "%s: Conflicting options: -c can not be used with -o\n", progname);
                     ASMX_usage();
                 }
+                if (!cl_Stdout)
+                {
+                    obj = OBJF_AddObj();
+                    obj->file = stdout;
+                }
                 cl_Stdout = true;
                 break;
 
             case 'd':
-                strncpy(line, optarg, 255);
-                linePtr = line;
-                TOKEN_GetWord(labl);
-                val = 0;
-                setSym = false;
-                token = TOKEN_GetWord(word);
-                if (token == ':')
-                {
-                    // allow ":="
-                    setSym = true;
-                    token = TOKEN_GetWord(word);
-                }
-                if (token == '=')
-                {
-                    neg = 1;
-                    if (TOKEN_GetWord(word) == '-')
-                    {
-                        neg = -1;
-                        TOKEN_GetWord(word);
-                    }
-                    val = neg * EvalNum(word);
-                    if (errFlag)
-                    {
-                        fprintf(stderr, "%s: Invalid number '%s' in -d option\n", progname, word);
-                        ASMX_usage();
-                    }
-                }
-                SYM_Def(labl, val, setSym, !setSym);
+                ASMX_DefineOpt(optarg);
                 break;
 
             case 'l':
@@ -6418,7 +9554,8 @@ static void getopts(int argc, char * const argv[])
                     optarg = "";
                     optind--;
                 }
-                strncpy(cl_ObjName, optarg, 255);
+                obj = OBJF_AddObj();
+                strncpy(obj->name, optarg, 255);
                 break;
 
             case 'C':
@@ -6441,19 +9578,66 @@ static void getopts(int argc, char * const argv[])
     argc -= optind;
     argv += optind;
 
-    if (cl_Stdout && cl_ObjType == OBJ_BIN)
+    // format options after the last -o or -c
+    if (cl_ObjOpt)
+    {
+        obj = objTab;
+        while (obj && obj->next)
+        {
+            obj = obj->next;
+        }
+
+        if (obj && obj->type != OBJ_HEX)
+        {
+            fprintf(stderr, "%s: Conflicting options: format option after the last -o, which already has a format\n", progname);
+            ASMX_usage();
+        }
+
+        if (obj)
+        {
+            // apply them to the last output, as in "-o file -b"
+            obj->type    = cl_ObjOpt->type;
+            obj->s9type  = cl_ObjOpt->s9type;
+            obj->binbase = cl_ObjOpt->binbase;
+            obj->binend  = cl_ObjOpt->binend;
+            obj->trslen  = cl_ObjOpt->trslen;
+            free(cl_ObjOpt);
+            cl_ObjOpt = NULL;
+        }
+        else
+        {
+            // -b or -9 or -t must force -o!
+            OBJF_AddObj();
+            cl_Obj = true;
+        }
+    }
+
+    for (obj = objTab; obj; obj = obj->next)
+    {
+        if (obj->file == stdout && obj->type == OBJ_BIN)
+        {
+            fprintf(stderr, "%s: Conflicting options: -b can not be used with -c\n", progname);
+            ASMX_usage();
+        }
+    }
+
+    if (cl_Stdout && varTab)
     {
-        fprintf(stderr, "%s: Conflicting options: -b can not be used with -c\n", progname);
+        fprintf(stderr, "%s: Conflicting options: -c can not be used with --variant\n", progname);
         ASMX_usage();
     }
 
-#if 1
-    // -b or -9 or -t must force -o!
-    if (cl_ObjType != OBJ_HEX && !cl_Stdout && !cl_Obj)
+    if (cl_SizesDiffName[0] && !cl_SizesName[0])
     {
-        cl_Obj = true;
+        fprintf(stderr, "%s: --sizes-diff needs --sizes\n", progname);
+        ASMX_usage();
+    }
+
+    if (cl_SizesLimit >= 0 && !cl_SizesDiffName[0])
+    {
+        fprintf(stderr, "%s: --sizes-limit needs --sizes-diff\n", progname);
+        ASMX_usage();
     }
-#endif
 
     // now argc is the number of remaining arguments
     // and argv[0] is the first remaining argument
@@ -6481,139 +9665,101 @@ static void getopts(int argc, char * const argv[])
         ASMX_usage();
     }
 
+    // default output file names for standard input are stdin.lst, etc.
+    const char *baseName = cl_SrcName;
+    if (strcmp(cl_SrcName, "-") == 0)
+    {
+        baseName = "stdin";
+    }
+
     if (cl_List && cl_ListName[0] == 0)
     {
-        strncpy(cl_ListName, cl_SrcName, 255-4);
+        strncpy(cl_ListName, baseName, 255-4);
         strcat (cl_ListName, ".lst");
     }
 
-    if (cl_Obj  && cl_ObjName [0] == 0)
+    for (obj = objTab; obj; obj = obj->next)
     {
-        switch (cl_ObjType)
+        if (obj->file == NULL && obj->name[0] == 0)
         {
-            case OBJ_S9:
-                strncpy(cl_ObjName, cl_SrcName, 255-3);
-                sprintf(word, ".s%d", cl_S9type);
-                strcat (cl_ObjName, word);
-                break;
+            switch (obj->type)
+            {
+                case OBJ_S9:
+                    strncpy(obj->name, baseName, 255-3);
+                    sprintf(word, ".s%d", obj->s9type);
+                    strcat (obj->name, word);
+                    break;
 
-            case OBJ_BIN:
-                strncpy(cl_ObjName, cl_SrcName, 255-4);
-                strcat (cl_ObjName, ".bin");
-                break;
+                case OBJ_BIN:
+                    strncpy(obj->name, baseName, 255-4);
+                    strcat (obj->name, ".bin");
+                    break;
 
-            case OBJ_TRSDOS:
-                strncpy(cl_ObjName, cl_SrcName, 255-4);
-                strcat (cl_ObjName, ".cmd");
-                break;
+                case OBJ_TRSDOS:
+                    strncpy(obj->name, baseName, 255-4);
+                    strcat (obj->name, ".cmd");
+                    break;
 
-            case OBJ_TRSCAS:
-                strncpy(cl_ObjName, cl_SrcName, 255-4);
-                strcat (cl_ObjName, ".cas");
-                break;
+                case OBJ_TRSCAS:
+                    strncpy(obj->name, baseName, 255-4);
+                    strcat (obj->name, ".cas");
+                    break;
 
-            default:
-            case OBJ_HEX:
-                strncpy(cl_ObjName, cl_SrcName, 255-4);
-                strcat (cl_ObjName, ".hex");
-                break;
+                default:
+                case OBJ_HEX:
+                    strncpy(obj->name, baseName, 255-4);
+                    strcat (obj->name, ".hex");
+                    break;
+            }
         }
     }
-}
-
-
-int main(int argc, char * const argv[])
-{
-    // initialize and get parms
 
-    progname   = argv[0];
-    pass       = 0;
-    symTab     = NULL;
-    xferAddr   = 0;
-    xferFound  = false;
-
-    macroTab   = NULL;
-    macPtr[0]  = NULL;
-    macLine[0] = NULL;
-    segTab     = NULL;
-    nullSeg    = SEG_Add("");
-    curSeg     = nullSeg;
-
-    cl_Err     = false;
-    cl_Warn    = false;
-    cl_List    = false;
-    cl_Obj     = false;
-    cl_ObjType = OBJ_HEX;
-    cl_ListP1  = false;
-    cl_trslen  = TRS_BUF_MAX;
-    cl_edtasm  = false;
-
-    asmTab     = NULL;
-    cpuTab     = NULL;
-    defCPU[0]  = 0;
-
-    nInclude  = -1;
-    for (int i = 0; i < MAX_INCLUDE; i++)
+    // two outputs can't write the same file
+    for (obj = objTab; obj; obj = obj->next)
     {
-        include[i] = NULL;
+        for (ObjRec *p = obj->next; p; p = p->next)
+        {
+            if (obj->file == NULL && p->file == NULL && strcmp(obj->name, p->name) == 0)
+            {
+                fprintf(stderr, "%s: Conflicting options: more than one -o writes '%s'\n", progname, obj->name);
+                ASMX_usage();
+            }
+        }
     }
+}
 
-    cl_SrcName [0] = 0;
-    source  = NULL;
-    cl_ListName[0] = 0;
-    listing = NULL;
-    cl_ObjName [0] = 0;
-    object  = NULL;
-    incbin = NULL;
-
-    ASMX_AsmInit();
-
-    getopts(argc, argv);
-
-    // open files
-
-    source = fopen(cl_SrcName, "r");
-    if (source == NULL)
-    {
-        fprintf(stderr, "Unable to open source input file '%s'!\n", cl_SrcName);
-        exit(1);
-    }
 
+// assemble the source file, returning the exit status
+static int ASMX_Assemble(void)
+{
     if (cl_List)
     {
-        listing = fopen(cl_ListName, "w");
+        listing = ASYNC_Open(cl_ListName, "w");
         if (listing == NULL)
         {
             fprintf(stderr, "Unable to create listing output file '%s'!\n", cl_ListName);
-            if (source)
-            {
-                fclose(source);
-            }
             exit(1);
         }
     }
 
-    if (cl_Stdout)
-    {
-        object = stdout;
-    }
-    else if (cl_Obj)
+    for (ObjRec *obj = objTab; obj; obj = obj->next)
     {
-        if (cl_ObjType == OBJ_BIN || cl_ObjType == OBJ_TRSDOS)
+        if (obj->file)
+        {
+            continue;
+        }
+
+        if (obj->type == OBJ_BIN || obj->type == OBJ_TRSDOS)
         {
-            object = fopen(cl_ObjName, "wb");
+            obj->file = ASYNC_Open(obj->name, "wb");
         }
         else
         {
-            object = fopen(cl_ObjName, "w");
+            obj->file = ASYNC_Open(obj->name, "w");
         }
-        if (object == NULL)
+        if (obj->file == NULL)
         {
-            fprintf(stderr, "Unable to create object output file '%s'!\n", cl_ObjName);
-            if (source)
-            {
-                fclose(source);
-            }
+            fprintf(stderr, "Unable to create object output file '%s'!\n", obj->name);
             if (listing)
             {
                 fclose(listing);
@@ -6624,11 +9770,50 @@ int main(int argc, char * const argv[])
 
     OBJF_CodeInit();
 
+    // with --relax, repeat pass 1 until no labels move
     pass = 1;
-    ASMX_DoPass();
+    relaxIter = 1;
+    do
+    {
+        relaxChanged = false;
+        STAT_PassStart();
+        ASMX_DoPass();
+        PROF_PassEnd();
+        STAT_PassEnd();
+        relaxIter++;
+    }
+    while (relaxFlag && (relaxIter == 2 || relaxChanged) && relaxIter <= MAX_RELAX);
+
+    if (relaxChanged)
+    {
+        fprintf(stderr, "%sInstruction sizes did not settle after %d passes\n", errPrefix, MAX_RELAX);
+    }
+
+    if (cl_RelaxName[0])
+    {
+        relaxFile = fopen(cl_RelaxName, "w");
+        if (relaxFile == NULL)
+        {
+            fprintf(stderr, "Unable to create relaxation report file '%s'!\n", cl_RelaxName);
+        }
+    }
 
     pass = 2;
+    STAT_PassStart();
     ASMX_DoPass();
+    PROF_PassEnd();
+    STAT_PassEnd();
+
+    if (relaxFlag)
+    {
+        if (cl_List)    RELAX_Summary(listing);
+        if (relaxFile)
+        {
+            RELAX_Summary(relaxFile);
+            fclose(relaxFile);
+            relaxFile = NULL;
+        }
+    }
 
     if (cl_edtasm)
     {
@@ -6639,23 +9824,263 @@ int main(int argc, char * const argv[])
     if (symtabFlag)
     {
         if (cl_List)    fprintf(listing, "\n");
+        SYM_MergeLocals(scopeTab);
+        SYM_MergeLocals(symTab);
         SYM_SortTab();
         SYM_DumpTab();
     }
 //  DumpMacroTab();
 
-    if (source)
+    bool ok = true;
+    if (cl_SymMapName[0])
     {
-        fclose(source);
+        ok = SYM_WriteMap();
+    }
+    if (cl_LineTabName[0])
+    {
+        ok = LTAB_Write() && ok;
+    }
+    if (cl_XrefName[0])
+    {
+        ok = SYM_WriteXref() && ok;
+    }
+    if (cl_SizesName[0])
+    {
+        ok = SIZE_Write() && ok;
     }
     if (listing)
     {
-        fclose(listing);
+        ok = ASYNC_CloseFile(listing, cl_ListName) && ok;
+        listing = NULL;
+    }
+    for (ObjRec *obj = objTab; obj; obj = obj->next)
+    {
+        if (obj->file && obj->file != stdout)
+        {
+            ok = ASYNC_CloseFile(obj->file, obj->name) && ok;
+            obj->file = NULL;
+        }
+    }
+
+    STAT_Report();
+    PROF_Report();
+
+    return (errCount != 0 || !ok);
+}
+
+
+#ifndef _WIN32
+// assemble one variant in a child process
+static void VAR_Child(VarRec *var)
+{
+    Str255 prefix;
+
+    // give each variant its own output files
+    VAR_FileName(cl_ListName, var -> name);
+    for (ObjRec *obj = objTab; obj; obj = obj->next)
+    {
+        VAR_FileName(obj->name, var -> name);
+    }
+    VAR_FileName(cl_StatsName, var -> name);
+    VAR_FileName(cl_ProfName, var -> name);
+    VAR_FileName(cl_ProfBytesName, var -> name);
+    VAR_FileName(cl_SymMapName, var -> name);
+    VAR_FileName(cl_LineTabName, var -> name);
+    VAR_FileName(cl_XrefName, var -> name);
+    VAR_FileName(cl_SizesName, var -> name);
+    VAR_FileName(cl_SizesDiffName, var -> name);
+    VAR_FileName(cl_RelaxName, var -> name);
+
+    snprintf(prefix, sizeof prefix, "[%s] ", var -> name);
+    errPrefix = prefix;
+
+    // apply the variant's defines
+    char *defs = var -> defs;
+    while (*defs)
+    {
+        int len = strcspn(defs, ",");
+        char c = defs[len];
+        defs[len] = 0;
+        Debleft(defs);
+        if (*defs)
+        {
+            ASMX_DefineOpt(defs);
+        }
+        defs[len] = c;
+        defs = defs + len + (c != 0);
+    }
+
+    exit(ASMX_Assemble());
+}
+#endif // _WIN32
+
+
+/*
+ *  VAR_Assemble - assembles all variants
+ *
+ *  The source and include files are loaded once before starting, then
+ *  each variant gets its own process (sharing the loaded files with
+ *  the parent) to run both passes with its own defines.  Up to cl_Jobs
+ *  variants are assembled at the same time.
+ */
+
+static int VAR_Assemble(void)
+{
+#ifdef _WIN32
+    fprintf(stderr, "%s: --variant is not supported on Windows\n", progname);
+    return 1;
+#else
+    struct
+    {
+        pid_t   pid;
+        VarRec  *var;
+    } job[256];
+    int     nJobs = 0;
+    int     result = 0;
+    int     status;
+
+    TEXT_Prefetch(srcFile);
+
+    if (cl_Jobs > (int) (sizeof job / sizeof job[0]))
+    {
+        cl_Jobs = sizeof job / sizeof job[0];
+    }
+
+    VarRec *var = varTab;
+    while (var || nJobs)
+    {
+        if (var && nJobs < cl_Jobs)
+        {
+            // start another variant
+            fflush(stdout);
+            fflush(stderr);
+            pid_t pid = fork();
+            if (pid < 0)
+            {
+                fprintf(stderr, "%s: Unable to start variant '%s'\n", progname, var -> name);
+                exit(1);
+            }
+            if (pid == 0)
+            {
+                VAR_Child(var);
+            }
+
+            job[nJobs].pid = pid;
+            job[nJobs].var = var;
+            nJobs++;
+            var = var -> next;
+        }
+        else
+        {
+            // wait for a variant to finish
+            pid_t pid = wait(&status);
+            if (pid < 0)
+            {
+                break;
+            }
+
+            for (int i = 0; i < nJobs; i++)
+            {
+                if (job[i].pid == pid)
+                {
+                    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                    {
+                        fprintf(stderr, "%s: Variant '%s' failed\n", progname, job[i].var -> name);
+                        result = 1;
+                    }
+                    job[i] = job[--nJobs];
+                    break;
+                }
+            }
+        }
+    }
+
+    return result;
+#endif
+}
+
+
+int main(int argc, char * const argv[])
+{
+    // initialize and get parms
+
+    progname   = argv[0];
+    pass       = 0;
+    symTab     = NULL;
+    xferAddr   = 0;
+    xferFound  = false;
+
+    macroTab   = NULL;
+    macPtr[0]  = NULL;
+    macLine[0] = NULL;
+    segTab     = NULL;
+    nullSeg    = SEG_Add("");
+    curSeg     = nullSeg;
+
+    cl_Err     = false;
+    cl_Warn    = false;
+    cl_List    = false;
+    cl_Obj     = false;
+    cl_ObjOpt  = NULL;
+    cl_ListP1  = false;
+    cl_RecLen  = IHEX_SIZE;
+    cl_Sorted  = false;
+    cl_edtasm  = false;
+    cl_Stats   = false;
+    cl_StatsText = false;
+    cl_StatsName[0] = 0;
+    cl_ProfName[0] = 0;
+    cl_ProfBytesName[0] = 0;
+    cl_SymMapName[0] = 0;
+    cl_LineTabName[0] = 0;
+    cl_XrefName[0] = 0;
+    cl_SizesName[0] = 0;
+    cl_SizesDiffName[0] = 0;
+    cl_SizesLimit = -1;
+    cl_RelaxName[0] = 0;
+    relaxFlag  = false;
+    cl_AsyncIO = false;
+#ifdef _WIN32
+    cl_Jobs    = 1;
+#else
+    cl_Jobs    = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (cl_Jobs < 1)
+    {
+        cl_Jobs = 1;
+    }
+
+    asmTab     = NULL;
+    cpuTab     = NULL;
+    defCPU[0]  = 0;
+
+    nInclude  = -1;
+
+    cl_SrcName [0] = 0;
+    srcFile = NULL;
+    cl_ListName[0] = 0;
+    listing = NULL;
+    objTab  = NULL;
+    incbin = NULL;
+
+    ASMX_AsmInit();
+
+    getopts(argc, argv);
+
+    // open files
+
+    srcFile = TEXT_LoadFile(cl_SrcName);
+    if (srcFile == NULL)
+    {
+        fprintf(stderr, "Unable to open source input file '%s'!\n", cl_SrcName);
+        exit(1);
     }
-    if (object && object != stdout)
+
+    if (varTab)
     {
-        fclose(object);
+        return VAR_Assemble();
     }
 
-    return (errCount != 0);
+    return ASMX_Assemble();
 }
+
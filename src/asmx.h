@@ -5,7 +5,8 @@
 
 enum
 {
-    IHEX_SIZE   = 32,       // max number of data bytes per line in hex object file
+    IHEX_SIZE   = 32,       // default number of data bytes per line in hex object file
+    MAX_RECLEN  = 250,      // max number of data bytes per line in hex object file
     MAXSYMLEN   = 32,       // max symbol length (only used in SYM_Dump())
     symTabCols  = 1,        // number of columns for symbol table dump
     MAXMACPARMS = 30,       // maximum macro parameters
@@ -14,15 +15,30 @@ enum
     MAX_COND    = 256,      // maximum nesting level of IF blocks
     MAX_MACRO   = 10,       // maximum nesting level of MACRO invocations
     TRS_BUF_MAX = 256,      // maximum buffer size for TRSDOS block
+    MAX_RELAX   = 20,       // maximum number of first pass iterations for --relax
 };
 
 #include <stdio.h>
 #include <sys/types.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+#include <time.h>
 #include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <stdint.h>
+#include <errno.h>
+
+// background output writer thread for --async-io, needs fopencookie()
+#if defined(__GLIBC__)
+#define ASYNC_IO
+#include <pthread.h>
+#include <semaphore.h>
+#endif
 
 
 #if defined(__clang__) // disable unwanted warnings for xcode
@@ -150,6 +166,13 @@ void INSTR_WL(uint16_t w1, uint32_t l1);
 void INSTR_L(uint32_t l1);
 void INSTR_LL(uint32_t l1, uint32_t l2);
 
+bool RELAX_Site(bool fits);
+void RELAX_Note(const char *form, int bytes, int cycles);
+
+uint32_t LPOOL_Add(uint32_t val, bool known);
+int LPOOL_Waiting(uint32_t *first);
+void LPOOL_Flush(void);
+
 char *LIST_Str(char *l, const char *s);
 char *LIST_Byte(char *p, uint8_t b);
 char *LIST_Word(char *p, uint16_t w);
@@ -174,6 +197,9 @@ extern  Str255          listLine;           // Current listing line
 extern  int             hexSpaces;          // flags for spaces in hex output for instructions
 extern  int             listWid;            // listing width: LIST_16, LIST_24
 extern  bool            exactFlag;          // true to disable assembler-specific optimizations
+extern  bool            relaxFlag;          // true to repeat pass 1 until instruction sizes settle (--relax)
+extern  bool            evalRelaxed;        // true if Eval used a forward reference that --relax made known
+extern  int             codeLabels;         // count of code labels defined, for CPUs that track state between labels
 
 // fallthrough annotation to prevent warnings
 #if defined(__clang__) && __cplusplus >= 201103L
@@ -87,7 +87,10 @@ struct OpcdRec Z8_opcdTab[] =
 };
 
 
-int rpReg; // current RP register set pointer
+int rpReg;      // current RP register set pointer
+bool rpAuto;    // true if SRP, labels, and jumps update rpReg (RP AUTO)
+int rpLabels;   // value of codeLabels when rpReg was last checked
+bool rpRelaxed; // true if a register in RP range was a --relax forward reference
 
 // --------------------------------------------------------------
 
@@ -248,7 +251,24 @@ static int Z8_RegNum(int reg)
 // note that this depends on evalKnown and must be done immediately after Eval()
 static bool Z8_IsRP(int reg)
 {
-    return evalKnown && rpReg >= 0 && (reg & 0xF0) == rpReg;
+    bool isRP = evalKnown && rpReg >= 0 && (reg & 0xF0) == rpReg;
+
+    if (isRP && evalRelaxed)
+    {
+        rpRelaxed = true;
+    }
+    return isRP;
+}
+
+
+// counts a working register form that is shorter than the form used
+// without RP, if --relax made one of its registers known
+static void Z8_NoteRP(void)
+{
+    if (rpRelaxed)
+    {
+        RELAX_Note("reg->working reg", 1, 4);
+    }
 }
 
 
@@ -303,10 +323,23 @@ int Z8_DoCPUOpcode(int typ, int parm)
     char    *oldLine;
 //  int     token;
 
+    if (rpAuto && rpLabels != codeLabels)
+    {
+        // any label could be a branch target from code with a different RP
+        rpReg = -1;
+    }
+    rpLabels = codeLabels;
+    rpRelaxed = false;
+
     switch (typ)
     {
         case OP_None:
             INSTR_B(parm);
+            if (rpAuto && (parm == 0xAF || parm == 0xBF))
+            {
+                // RET and IRET don't fall through
+                rpReg = -1;
+            }
             break;
 
         case OP_LD:
@@ -387,6 +420,7 @@ int Z8_DoCPUOpcode(int typ, int parm)
                             {
                                 // LD Rr,@Rs => E3 ds
                                 INSTR_BB(0xE3, Z8_RegNum(reg1)*16 + (reg2 & 0x0F));
+                                Z8_NoteRP();
                             }
                             else
                             {
@@ -510,11 +544,13 @@ int Z8_DoCPUOpcode(int typ, int parm)
                                 {
                                     // LD Rr,Rr => r8 rr
                                     INSTR_BB(Z8_RegNum(reg1)*16 + 0x08, reg2);
+                                    Z8_NoteRP();
                                 }
                                 else if (Z8_IsRP(reg2))
                                 {
                                     // LD reg,Rr => x9 rr
                                     INSTR_BB(reg2*16 + 0x09, reg1);
+                                    Z8_NoteRP();
                                 }
                                 else
                                 {
@@ -530,6 +566,7 @@ int Z8_DoCPUOpcode(int typ, int parm)
                                 {
                                     // LD Rd,@Rs => E3 ds
                                     INSTR_BB(0xE3, (reg1 & 0x0F)*16 + Z8_RegNum(reg2));
+                                    Z8_NoteRP();
                                 }
                                 else
                                 {
@@ -547,6 +584,7 @@ int Z8_DoCPUOpcode(int typ, int parm)
                                 {
                                     // LD Rr,@Rr => E3 ds
                                     INSTR_BB(0xE3, (reg1 & 0x0F)*16 + (reg2 & 0x0F));
+                                    Z8_NoteRP();
                                 }
                                 else
                                 {
@@ -562,6 +600,7 @@ int Z8_DoCPUOpcode(int typ, int parm)
                                 {
                                     // LD Rr,#imm => rC ii
                                     INSTR_BB((reg1 & 0x0F)*16 + 0x0C, val);
+                                    Z8_NoteRP();
                                 }
                                 else
                                 {
@@ -599,6 +638,7 @@ int Z8_DoCPUOpcode(int typ, int parm)
                             {
                                 // LD @Rd,Rs => F3 ds
                                 INSTR_BB(0xF3, (reg1 & 0x0F)*16 + (reg2 & 0x0F));
+                                Z8_NoteRP();
                             }
                             else
                             {
@@ -616,6 +656,7 @@ int Z8_DoCPUOpcode(int typ, int parm)
                             {
                                 // LD @Rr,Rr => F3 ds
                                 INSTR_BB(0xF3, (reg1 & 0x0F)*16 + (reg2 & 0x0F));
+                                Z8_NoteRP();
                             }
                             else
                             {
@@ -648,6 +689,11 @@ int Z8_DoCPUOpcode(int typ, int parm)
             reg1 = Z8_GetCond();
             val = EXPR_EvalBranch(2);
             INSTR_BB(reg1*16 + 0x0B, val);
+            if (rpAuto && reg1 == 8)
+            {
+                // JR without a condition doesn't fall through
+                rpReg = -1;
+            }
             break;
 
         case OP_JP:
@@ -692,6 +738,11 @@ int Z8_DoCPUOpcode(int typ, int parm)
                     ASMX_IllegalOperand();
                     break;
             }
+            if (rpAuto && reg1 == 8)
+            {
+                // JP without a condition doesn't fall through
+                rpReg = -1;
+            }
             break;
 
         case OP_DJNZ:
@@ -939,6 +990,7 @@ int Z8_DoCPUOpcode(int typ, int parm)
                             {
                                 // OP Rd,Rs => 02 ds
                                 INSTR_BB(parm + 0x02, (reg1 & 0x0F)*16 + (reg2 & 0x0F));
+                                Z8_NoteRP();
                             }
                             else
                             {
@@ -959,6 +1011,7 @@ int Z8_DoCPUOpcode(int typ, int parm)
                             {
                                 // OP Rd,@Rs => 03 ds
                                 INSTR_BB(parm + 0x03, (reg1 & 0x0F)*16 + (reg2 & 0x0F));
+                                Z8_NoteRP();
                             }
                             else
                             {
@@ -1134,6 +1187,10 @@ int Z8_DoCPUOpcode(int typ, int parm)
                     // SRP #ii => 31 ii
                     val = EXPR_Eval();
                     INSTR_BB(0x31, val);
+                    if (rpAuto)
+                    {
+                        rpReg = evalKnown ? (val & 0xF0) : -1;
+                    }
                     break;
 
                 case reg_EOL:
@@ -1149,6 +1206,7 @@ int Z8_DoCPUOpcode(int typ, int parm)
             return 0;
             break;
     }
+
     return 1;
 }
 
@@ -1162,16 +1220,21 @@ int Z8_DoCPULabelOp(int typ, int parm, char *labl)
         case OP_RP:
             // RP pseudo-op
             // This sets the expected value of the register pointer to
-            // optimize Rxx addressing modes to Rn, or you can turn it OFF
+            // optimize Rxx addressing modes to Rn, or you can turn it OFF,
+            // or AUTO to follow SRP instructions
 
             if (labl[0])
             {
                 ASMX_Error("Label not allowed");
             }
 
-            if (REG_Get("OFF") == 0)
+            rpLabels = codeLabels;
+            int reg = REG_Get("OFF AUTO");
+            if (reg >= 0)
             {
                 // RP OFF to disable RP optimizations
+                // RP AUTO to follow SRP instructions until the next label or jump
+                rpAuto = (reg == 1);
                 rpReg = -1;
                 char *p = listLine + 2;
                 p = LIST_Str(p, "--");
@@ -1196,6 +1259,7 @@ int Z8_DoCPULabelOp(int typ, int parm, char *labl)
                         val = val*16;
                     }
                     rpReg = val;
+                    rpAuto = false;
 
                     if (pass == 2)
                     {
@@ -1218,6 +1282,8 @@ void Z8_PassInit(void)
 {
     // start each pass with RP optimizations disabled
     rpReg = -1;
+    rpAuto = false;
+    rpLabels = codeLabels;
 }
 
 
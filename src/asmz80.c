@@ -296,6 +296,45 @@ static void Z80_DoArith(int imm, int reg)
 }
 
 
+// with --relax, assemble JP or JP NZ/Z/NC/C as JR if the target is in range
+// returns true if a JR was assembled
+static bool Z80_RelaxJP(int cond, int val)
+{
+    if (!relaxFlag || exactFlag || cond > 3)
+    {
+        return false;
+    }
+
+    int ofs = val - (locPtr + 2);
+    if (!evalKnown || ofs < -128 || ofs > 127)
+    {
+        return false;
+    }
+
+    if (cond < 0)
+    {
+        INSTR_BB(0x18, ofs);
+    }
+    else
+    {
+        INSTR_BB(0x20 + cond*8, ofs);
+    }
+
+    // JR is faster than JP on the Gameboy, and slower on a Z80 except for
+    // an untaken JR cc, so those cycles aren't counted
+    if (curCPU == CPU_GBZ80)
+    {
+        RELAX_Note(cond < 0 ? "JP->JR" : "JP cc->JR cc", 1, 4);
+    }
+    else
+    {
+        RELAX_Note(cond < 0 ? "JP->JR" : "JP cc->JR cc", 1, cond < 0 ? -2 : 0);
+    }
+
+    return true;
+}
+
+
 static int Z80_DoCPUOpcode(int typ, int parm)
 {
     int     val, reg1, reg2;
@@ -1246,6 +1285,10 @@ static int Z80_DoCPUOpcode(int typ, int parm)
                 {
                     linePtr = oldLine;
                     val = EXPR_Eval();
+                    if ((parm >> 8) == 0xC3 && Z80_RelaxJP(reg1, val))
+                    {
+                        break;
+                    }
                     INSTR_BW(parm >> 8, val);
                 }
                 else
@@ -1256,6 +1299,10 @@ static int Z80_DoCPUOpcode(int typ, int parm)
                     {
                         ASMX_IllegalOperand();
                     }
+                    else if ((parm >> 8) == 0xC3 && Z80_RelaxJP(reg1, val))
+                    {
+                        break;
+                    }
                     else
                     {
                         INSTR_BW((parm & 255) + reg1*8, val);
@@ -0,0 +1,19 @@
+; ARMPOOL.ASM - ARM LDR Rd,=value, rotated immediates, and LTORG
+
+	ORG	0
+
+START	LDR	R0,=0xFF		; MOV R0,#0xFF
+	LDR	R1,=0xFF000000		; rotated immediate, MOV
+	LDR	R2,=0xFFFFFF00		; MVN R2,#0xFF
+	LDR	R3,=0x12345678		; from the pool
+	LDR	R4,=0x12345678		; same slot
+	LDR	R5,=FWD			; forward reference, MOV with --relax
+	LDREQ	R6,=0x87654321		; conditional
+	MOV	R7,#0x3FC
+	MOV	PC,LR
+	LTORG
+
+FWD	LDR	R0,=0xABCDEF01		; pool at END
+	MOV	PC,LR
+
+	END
@@ -0,0 +1,28 @@
+; COND.ASM - lines skipped inside failed IF blocks
+
+	IF 0
+	NOP
+.skip	ENDIF			; temp label before ENDIF
+
+	IF 0
+	DB	1
+@t1:	ELSE			; '@' temp label before ELSE
+	DB	2
+	ENDIF
+
+	IF 0
+	DB	3
+lbl:	ELSIF 1			; label with colon before ELSIF
+	DB	4
+	ENDIF
+
+	IF 0
+	DB	5
+	 IF 1			; nested IF stays failed
+	 DB	6
+	 ENDIF
+	DB	7
+.ENDIF				; ".ENDIF" in column 1 is the pseudo-op
+
+	DB	8
+	END
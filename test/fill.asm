@@ -0,0 +1,17 @@
+; FILL.ASM - FILL pseudo-op and DS with an initializer
+
+	FILL	4,0xE5		; 4 bytes
+	FILL.B	3,0x11
+	FILL.W	3,0x1234	; big endian words
+	FILL.L	2,0x89ABCDEF
+	FILL	0,0xFF		; nothing
+
+	DS	4,0x22		; short DS goes through bytStr
+	DS.W	2,0x5678
+	DS	1100,0x33	; longer than MAX_BYTSTR, streamed
+	DS.L	300,0x01020304	; streamed longwords
+
+	DS	8		; uninitialized
+	DB	0x99
+
+	END
@@ -0,0 +1,19 @@
+; LINETAB.ASM - --linetab address to source line table
+
+CLEAR	MACRO	reg
+	CLR	reg
+	ENDM
+
+	ORG	$1000
+
+START	JSR	INIT
+	CLEAR	$20		; macro expansion
+	CLEAR	$21
+	BRA	START
+
+	INCLUDE	linetab.inc
+
+	ORG	$1100		; gap in the addresses
+	FCB	1,2,3
+
+	END	START
@@ -0,0 +1,12 @@
+; OBJS.ASM - several object outputs from one assembly
+; testit makes objs.asm.hex, objs.asm.s37, and objs.asm.bin
+
+	ORG	0x1000
+start	MOVEQ	#1,D0
+	BRA.S	start
+
+	ORG	0x1010
+	DC.W	0x1234, 0x5678
+	DC.B	"objs"
+
+	END	start
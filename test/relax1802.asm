@@ -0,0 +1,15 @@
+; RELAX1802.ASM - 1802 generic branches with --relax
+
+	ORG	0
+
+START	JBR	NEXT		; BR to the next instruction
+NEXT	JBZ	FWD		; forward on the same page, BZ
+	JBDF	FAR		; another page, LBDF
+	JBNQ	START		; backward, BNQ
+FWD	REQ
+
+	ORG	0x01FF
+EDGE	JBQ	FAR		; the operand byte is on the next page with FAR, BQ
+FAR	JBR	START		; another page, LBR
+
+	END
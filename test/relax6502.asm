@@ -0,0 +1,16 @@
+; RELAX6502.ASM - 6502 zero page forward references with --relax
+
+	ORG	$1000
+
+START	LDA	PTR		; zero page once PTR is known
+	STA	PTR+1,X		; zero page,X
+	LDX	PTR,Y		; zero page,Y
+	LDA	PTR,Y		; no zero page,Y for LDA, stays absolute
+	LDA	BUF		; not in zero page, stays absolute
+	JMP	START
+
+BUF	DS	4
+
+PTR	EQU	$80
+
+	END
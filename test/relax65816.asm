@@ -0,0 +1,16 @@
+; RELAX65816.ASM - 65C816 forward references with --relax
+
+	ORG	$1000
+
+START	LDA	PTR		; zero page
+	LDA	FAR		; absolute long, a byte longer
+	LDA	FAR,X		; absolute long,X
+	LDA	DATA		; absolute
+	RTS
+
+DATA	DB	0
+
+PTR	EQU	$80
+FAR	EQU	$123456
+
+	END
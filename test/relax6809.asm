@@ -0,0 +1,21 @@
+; RELAX6809.ASM - 6809 generic branches and forward references with --relax
+
+	ORG	$1000
+	SETDP	$00
+
+START	JBRA	NEXT		; to the next instruction, BRA 0
+NEXT	JBEQ	FWD		; forward, becomes BEQ
+	JBSR	FWD		; becomes BSR
+	LDA	VAR		; direct once VAR is known
+	LDA	OFS,X		; 5-bit offset
+	LDA	OFS2,X		; 8-bit offset
+FWD	JBNE	FAR		; too far, stays LBNE
+	DS	200
+FAR	JBRA	START		; too far back, LBRA
+	RTS
+
+VAR	EQU	$20
+OFS	EQU	4
+OFS2	EQU	$40
+
+	END
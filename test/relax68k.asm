@@ -0,0 +1,12 @@
+; RELAX68K.ASM - 68000 branch sizes with --relax
+
+START	BRA	NEXT		; branch to the next instruction stays .W
+NEXT	BNE	FWD		; forward, short once FWD is known
+	NOP
+FWD	BEQ	FAR		; forward, too far for .S
+	BSR	START		; backward, short
+	DS	200
+FAR	BRA	START		; backward, too far for .S
+	RTS
+
+	END
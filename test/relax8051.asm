@@ -0,0 +1,21 @@
+; RELAX8051.ASM - 8051 generic JMP and CALL with --relax
+
+	ORG	0
+
+START	JMP	NEXT		; SJMP to the next instruction
+NEXT	JMP	MID		; forward, too far for SJMP, AJMP
+	CALL	MID		; ACALL
+	CALL	OTHER		; another 2K page, LCALL
+	JMP	OTHER		; LJMP
+	DS	200
+MID	JMP	START		; too far back for SJMP, AJMP
+	JMP	$		; SJMP
+
+	ORG	0x0FFE
+EDGE	JMP	FAR		; the next instruction is in FAR's 2K page, AJMP
+OTHER	RET
+
+	ORG	0x1100
+FAR	RET
+
+	END
@@ -0,0 +1,68 @@
+; RELAXFAR1802.ASM - many 1802 generic branches to another page
+
+	ORG	0
+
+START	JBZ	FAR		; LBZ
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+	JBNZ	FAR
+
+	ORG	0200H
+FAR	JBR	START		; LBR
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+	JBQ	START
+
+	END
@@ -0,0 +1,67 @@
+; RELAXFAR68K.ASM - many 68000 branches that need the word form
+
+	ORG	0
+
+START	BRA	FAR		; too far forward
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	BNE	FAR
+	DS	300
+FAR	BRA	START		; too far back
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+	BEQ	START
+
+	END
@@ -0,0 +1,41 @@
+; RELAXFAR8048.ASM - many 8048 calls and jumps to the other bank
+
+	ORG	0
+
+	SELMB	AUTO
+START	CALL	FAR		; SEL MB1 inserted
+L0	CALL	FAR		; SEL MB1 again after each label
+L1	CALL	FAR
+L2	CALL	FAR
+L3	CALL	FAR
+L4	CALL	FAR
+L5	CALL	FAR
+L6	CALL	FAR
+L7	CALL	FAR
+L8	CALL	FAR
+L9	CALL	FAR
+L10	CALL	FAR
+L11	CALL	FAR
+L12	CALL	FAR
+L13	CALL	FAR
+L14	CALL	FAR
+L15	CALL	FAR
+L16	CALL	FAR
+L17	CALL	FAR
+L18	CALL	FAR
+L19	CALL	FAR
+L20	CALL	FAR
+L21	CALL	FAR
+L22	CALL	FAR
+L23	CALL	FAR
+L24	CALL	FAR
+L25	CALL	FAR
+L26	CALL	FAR
+L27	CALL	FAR
+L28	CALL	FAR
+	JMP	FAR
+
+	ORG	0x0800
+FAR	RET
+
+	END
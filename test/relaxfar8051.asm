@@ -0,0 +1,39 @@
+; RELAXFAR8051.ASM - many 8051 JMP and CALL to another 2K page
+
+	ORG	0
+
+START	CALL	FAR		; LCALL
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	CALL	FAR
+	JMP	FAR		; LJMP
+	JMP	FAR		; LJMP
+	JMP	FAR		; LJMP
+	JMP	FAR		; LJMP
+	JMP	FAR		; LJMP
+
+	ORG	2000H
+FAR	RET
+
+	END
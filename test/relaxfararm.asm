@@ -0,0 +1,41 @@
+; RELAXFARARM.ASM - many ARM LDR Rd,= of forward labels that need the pool
+
+	ORG	0
+
+START	LDR	R0,=FAR		; 0x1234 is not a rotated immediate
+	LDR	R0,=FAR
+	LDR	R1,=FAR
+	LDR	R2,=FAR
+	LDR	R3,=FAR
+	LDR	R4,=FAR
+	LDR	R5,=FAR
+	LDR	R6,=FAR
+	LDR	R7,=FAR
+	LDR	R8,=FAR
+	LDR	R9,=FAR
+	LDR	R10,=FAR
+	LDR	R11,=FAR
+	LDR	R12,=FAR
+	LDR	R0,=FAR
+	LDR	R1,=FAR
+	LDR	R2,=FAR
+	LDR	R3,=FAR
+	LDR	R4,=FAR
+	LDR	R5,=FAR
+	LDR	R6,=FAR
+	LDR	R7,=FAR
+	LDR	R8,=FAR
+	LDR	R9,=FAR
+	LDR	R10,=FAR
+	LDR	R11,=FAR
+	LDR	R12,=FAR
+	LDR	R0,=FAR
+	LDR	R1,=FAR
+	LDR	R2,=FAR
+	MOV	PC,LR
+	LTORG
+
+	ORG	0x1234
+FAR	MOV	PC,LR
+
+	END
@@ -0,0 +1,68 @@
+; RELAXFARTHUMB.ASM - many Thumb JBcc out of range
+
+	ORG	0
+
+START	JBEQ	FAR		; BNE around a B
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	JBNE	FAR
+	DS	300
+FAR	JBCS	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	JBCC	START
+	BX	LR
+
+	END
@@ -0,0 +1,14 @@
+; RELAXZ80.ASM - Z80 JP to JR with --relax
+
+START	JP	NEXT		; to the next instruction, JR 0
+NEXT	JP	NZ,FWD		; forward, becomes JR NZ
+	JP	PE,FWD		; no JR PE, stays JP
+	JP	(HL)		; never changed
+	CALL	FWD		; never changed
+FWD	JP	FAR		; too far, stays JP
+	JP	C,START		; backward, becomes JR C
+	DS	200
+FAR	JP	START		; too far back, stays JP
+	JP	Z,FAR		; becomes JR Z
+
+	END
@@ -0,0 +1,17 @@
+; SELMB.ASM - 8048 SELMB AUTO
+
+	ORG	0
+
+	SELMB	AUTO
+START	CALL	SUB0		; same bank, no SEL MB
+	CALL	SUB1		; other bank, SEL MB1 inserted
+	SEL	MB0		; bank must go back, kept
+	SEL	MB0		; already selected, removed
+	JMP	FAR		; other bank, SEL MB1 inserted
+SUB0	RET
+
+	ORG	0x0800
+FAR	JMP	SUB1		; same bank, no SEL MB
+SUB1	RET
+
+	END
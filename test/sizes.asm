@@ -0,0 +1,21 @@
+; SIZES.ASM - --sizes and --sizes-diff size report
+
+	ORG	$1000
+
+START	JSR	INIT
+	JSR	PRINT
+	BRA	START
+
+PRINT	LDA	,X+		; global label
+.LOOP	BEQ	.DONE		; temp labels don't start a new entry
+	STA	$FF01
+	BRA	.LOOP
+.DONE	RTS
+
+	INCLUDE	sizes.inc
+
+	SEG	DATA
+	ORG	$2000
+TABLE	FCB	1,2,3,4,5,6,7,8
+
+	END	START
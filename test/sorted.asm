@@ -0,0 +1,15 @@
+; SORTED.ASM - --sorted writes object code in address order
+
+	ORG	0x0200
+	DB	"second block"
+
+	ORG	0x0100
+	DB	1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12
+
+	ORG	0x0300
+	DW	0x1234, 0x5678
+
+	ORG	0x010C		; continues the first block
+	DB	13, 14, 15, 16
+
+	END
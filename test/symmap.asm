@@ -0,0 +1,19 @@
+; SYMMAP.ASM - --symmap binary symbol map
+
+	ORG	$1000
+
+START	JSR	INIT
+	LDX	#TABLE
+.LOOP	LDA	,X+		; temp label
+	BNE	.LOOP
+	BRA	START
+COUNT	SET	1
+COUNT	SET	2		; SET symbol
+
+	INCLUDE	symmap.inc
+
+	SEG	DATA
+	ORG	$2000
+TABLE	FCB	1,2,3,0
+
+	END	START
@@ -0,0 +1,28 @@
+; THUMBPOOL.ASM - Thumb LDR Rd,=value, literal pools, and JBcc
+
+	ORG	0
+
+START	LDR	R0,=0x12345678
+	LDR	R1,=FWD		; forward reference, gets its own slot
+	LDR	R2,=0x12345678	; same known value, shares a slot
+	JBEQ	START		; in range, BEQ
+	JBNE	FAR		; out of range, BEQ around a B
+NEXT	BX	LR		; pool goes after BX
+
+	LDR	R3,=0xCAFE
+	DS	1010
+	ADD	R0,R1		; pool would go out of range, B around it
+	ADD	R0,R1
+
+	POOL	OFF		; no pools in a jump table
+	LDR	R4,=0xBEEF
+TABLE	B	START
+	B	NEXT
+	B	FWD
+	LTORG
+	POOL	AUTO
+
+FWD	DS	300
+FAR	B	START
+
+	END
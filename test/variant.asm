@@ -0,0 +1,11 @@
+; VARIANT.ASM - --variants and --jobs, with X defined by variant.txt
+
+	ORG	$1000
+
+	IF	X == 1
+	LDA	#$11
+	ELSE
+	LDA	#$22
+	ENDIF
+	LDB	#X
+	RTS
@@ -0,0 +1,15 @@
+; XREF.ASM - --xref cross reference
+
+	ORG	$1000
+
+START	JSR	INIT		; forward reference
+	LDA	PORT
+	STA	PORT,X
+	LDX	#START+PORT	; two symbols on one line
+	BRA	START
+
+	INCLUDE	xref.inc
+
+UNUSED	RTS			; defined, never used
+
+	END	START
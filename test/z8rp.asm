@@ -0,0 +1,24 @@
+; Z8RP.ASM - Z8 RP AUTO and working register forms
+
+	ORG	0
+
+	RP	AUTO
+START	SRP	#0x10
+	LD	VAR1,VAR2	; both forward, working regs with --relax
+	LD	VAR1,#5		; LD Rr,#imm
+	ADD	VAR1,VAR2	; OP Rd,Rs
+	LD	R3,VAR2		; same size either way, not counted
+	LD	0x20,VAR1	; LD reg,Rr
+	JR	NEXT
+NEXT	LD	VAR1,VAR2	; after a label, RP is unknown
+	SRP	#0x20
+	LD	0x21,0x22	; in the new set
+	RP	0x10		; turns RP AUTO off
+	SRP	#0x20
+	LD	VAR1,VAR2	; still uses RP 0x10
+	RET
+
+VAR1	EQU	0x14
+VAR2	EQU	0x15
+
+	END